@@ -1,4 +1,38 @@
 #ifndef JSON_CONFIG_H_INCLUDED
 # define JSON_CONFIG_H_INCLUDED
 # define JSON_API
+
+/// If defined, integers are limited to 32 bits and Value::Int64/UInt64
+/// are not available.
+//# define JSON_NO_INT64 1
+
+/// If defined, Reader still accepts comments but drops them, and Value
+/// keeps none: setComment() does nothing and hasComment() is always
+/// false, so neither the reader nor the writers pay for comments.
+//# define JSON_NO_COMMENTS 1
+
+# if __cplusplus >= 201103L  ||  (defined(_MSC_VER)  &&  _MSC_VER >= 1600)
+#  define JSON_HAS_RVALUE_REFERENCES 1
+# endif
+
+namespace Json {
+    typedef int Int;
+    typedef unsigned int UInt;
+# if defined(JSON_NO_INT64)
+    typedef int LargestInt;
+    typedef unsigned int LargestUInt;
+# else
+#  if defined(_MSC_VER)
+    typedef __int64 Int64;
+    typedef unsigned __int64 UInt64;
+#  else
+    typedef long long int Int64;
+    typedef unsigned long long int UInt64;
+#  endif
+    typedef Int64 LargestInt;
+    typedef UInt64 LargestUInt;
+#  define JSON_HAS_INT64
+# endif
+} // namespace Json
+
 #endif // JSON_CONFIG_H_INCLUDED
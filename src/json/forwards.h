@@ -9,9 +9,14 @@ namespace Json {
     class Reader;
     class StyledWriter;
     class StaticString;
+    class Tape;
+    class TapeView;
+    class MemberNameTable;
     class Path;
     class PathArgument;
     class Value;
+    class ValueAllocator;
+    class ValueArena;
     class ValueIteratorBase;
     class ValueIterator;
     class ValueConstIterator;
@@ -5,5 +5,6 @@
 # include "value.h"
 # include "reader.h"
 # include "writer.h"
+# include "tape.h"
 
 #endif
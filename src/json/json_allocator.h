@@ -3,6 +3,15 @@
 
 # include <stdlib.h>
 # include <assert.h>
+# include <new>
+
+// The shared pools below need std::mutex and thread_local: the library
+// sources are C++11, though the public headers still build as C++03.
+# if __cplusplus < 201103L  &&  !(defined(_MSC_VER)  &&  _MSC_VER >= 1900)
+#  error The jsoncpp sources must be compiled as C++11 or later.
+# endif
+
+# include <mutex>
 
 namespace Json {
 
@@ -82,9 +91,13 @@ private:
         const unsigned int mallocSize = sizeof(BatchInfo) - sizeof(AllocatedType)* objectPerAllocation
                                           + sizeof(AllocatedType) * objectPerAllocation * objectsPerPage;
         BatchInfo *batch = static_cast<BatchInfo*>( malloc( mallocSize ) );
+        if ( batch == 0 )
+        {
+            throw std::bad_alloc();
+        }
         batch->next_ = 0;
         batch->used_ = batch->buffer_;
-        batch->end_ = batch->buffer_ + objectsPerPage;
+        batch->end_ = batch->buffer_ + objectPerAllocation * objectsPerPage;
         return batch;
     }
 
@@ -95,6 +108,153 @@ private:
     unsigned int objectsPerPage_;
 };
 
+/// Process-wide BatchAllocator shared by every thread. Each thread keeps a
+/// cache of free objects and trades them with the shared free list in
+/// bundles, so the lock is taken once per bundle rather than per object.
+/// Batches belong to the shared pool, so an object may be released by a
+/// different thread than the one that allocated it. releaseThreadCache()
+/// returns a thread's cache in bulk; thread exit does the same.
+template<typename AllocatedType,const unsigned int objectPerAllocation>
+class SharedBatchAllocator
+{
+public:
+    typedef AllocatedType Type;
+
+    static AllocatedType *allocate()
+    {
+        ThreadCache &cache = threadCache();
+        if ( cache.head_ == 0 )
+        {
+            refill( cache );
+        }
+        FreeObject *object = cache.head_;
+        cache.head_ = object->next_;
+        --cache.count_;
+        return reinterpret_cast<AllocatedType *>( object );
+    }
+
+    static void release( AllocatedType *object )
+    {
+        assert( object != 0 );
+        ThreadCache &cache = threadCache();
+        FreeObject *freed = reinterpret_cast<FreeObject *>( object );
+        freed->next_ = cache.head_;
+        cache.head_ = freed;
+        ++cache.count_;
+        if ( cache.exited_ )
+        {
+            flush( cache, cache.count_ );
+        }
+        else if ( cache.count_ >= 2 * bundleSize )
+        {
+            flush( cache, bundleSize );
+        }
+    }
+
+    static void releaseThreadCache()
+    {
+        ThreadCache &cache = threadCache();
+        flush( cache, cache.count_ );
+    }
+
+private:
+    enum { bundleSize = 64 };
+
+    struct FreeObject
+    {
+        FreeObject *next_;
+    };
+
+    // Plain data, so it stays usable while the thread's destructors run.
+    struct ThreadCache
+    {
+        FreeObject *head_;
+        unsigned int count_;
+        bool exited_;
+    };
+
+    struct ThreadCacheFlusher
+    {
+        ~ThreadCacheFlusher()
+        {
+            ThreadCache &cache = threadCache();
+            flush( cache, cache.count_ );
+            cache.exited_ = true;
+        }
+    };
+
+    struct Shared
+    {
+        Shared()
+            : head_( 0 )
+        {
+        }
+
+        std::mutex mutex_;
+        BatchAllocator<AllocatedType, objectPerAllocation> batches_;
+        FreeObject *head_;
+    };
+
+    // The flusher is registered on first use, so a thread that only
+    // releases objects returns its cache on exit too.
+    static ThreadCache &threadCache()
+    {
+        static thread_local ThreadCache cache;
+        static thread_local ThreadCacheFlusher flusher;
+        (void)flusher;
+        return cache;
+    }
+
+    // Never destroyed: values may still be released by static destructors.
+    static Shared &shared()
+    {
+        static Shared *shared = new Shared();
+        return *shared;
+    }
+
+    static void refill( ThreadCache &cache )
+    {
+        Shared &pool = shared();
+        std::lock_guard<std::mutex> lock( pool.mutex_ );
+        for ( unsigned int count = 0; count < bundleSize; ++count )
+        {
+            FreeObject *object = pool.head_;
+            if ( object )
+            {
+                pool.head_ = object->next_;
+            }
+            else
+            {
+                object = reinterpret_cast<FreeObject *>( pool.batches_.allocate() );
+            }
+            object->next_ = cache.head_;
+            cache.head_ = object;
+            ++cache.count_;
+        }
+    }
+
+    static void flush( ThreadCache &cache, unsigned int count )
+    {
+        if ( count == 0 )
+        {
+            return;
+        }
+        FreeObject *first = cache.head_;
+        FreeObject *last = first;
+        for ( unsigned int index = 1; index < count; ++index )
+        {
+            last = last->next_;
+        }
+        cache.head_ = last->next_;
+        cache.count_ -= count;
+
+        Shared &pool = shared();
+        std::lock_guard<std::mutex> lock( pool.mutex_ );
+        last->next_ = pool.head_;
+        pool.head_ = first;
+    }
+};
+
 } // namespace Json
 
 #endif // JSONCPP_BATCHALLOCATOR_H_INCLUDED
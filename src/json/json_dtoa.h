@@ -0,0 +1,391 @@
+#ifndef JSONCPP_DTOA_H_INCLUDED
+# define JSONCPP_DTOA_H_INCLUDED
+
+# include <string.h>
+
+// Grisu2 double to shortest decimal conversion (Florian Loitsch, "Printing
+// Floating-Point Numbers Quickly and Accurately with Integers", PLDI 2010).
+// The digits always read back to the same double; in rare cases one digit
+// longer than the shortest possible form.
+
+namespace Json {
+
+struct DiyFp
+{
+    DiyFp()
+    {
+    }
+
+    DiyFp( unsigned long long f, int e )
+        : f_( f )
+        , e_( e )
+    {
+    }
+
+    explicit DiyFp( double value )
+    {
+        unsigned long long bits;
+        memcpy( &bits, &value, sizeof(bits) );
+        int biasedExponent = int( (bits >> 52) & 0x7FF );
+        f_ = bits & (hiddenBit - 1);
+        if ( biasedExponent != 0 )
+        {
+            f_ += hiddenBit;
+            e_ = biasedExponent - exponentBias;
+        }
+        else
+        {
+            e_ = 1 - exponentBias;
+        }
+    }
+
+    DiyFp operator -( const DiyFp &other ) const
+    {
+        return DiyFp( f_ - other.f_, e_ );
+    }
+
+    // Upper 64 bits of the 128-bit product, rounded.
+    DiyFp operator *( const DiyFp &other ) const
+    {
+        const unsigned long long mask32 = 0xFFFFFFFF;
+        unsigned long long a = f_ >> 32, b = f_ & mask32;
+        unsigned long long c = other.f_ >> 32, d = other.f_ & mask32;
+        unsigned long long ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+        unsigned long long middle = (bd >> 32) + (ad & mask32) + (bc & mask32) + (1ULL << 31);
+        return DiyFp( ac + (ad >> 32) + (bc >> 32) + (middle >> 32), e_ + other.e_ + 64 );
+    }
+
+    DiyFp normalize() const
+    {
+        DiyFp result = *this;
+        while ( !(result.f_ & hiddenBit) )
+        {
+            result.f_ <<= 1;
+            --result.e_;
+        }
+        result.f_ <<= 11;
+        result.e_ -= 11;
+        return result;
+    }
+
+    // Boundaries m- and m+ of the rounding interval of a double, with the
+    // same exponent and m+ normalized.
+    void normalizedBoundaries( DiyFp &minus, DiyFp &plus ) const
+    {
+        plus = DiyFp( (f_ << 1) + 1, e_ - 1 );
+        while ( !(plus.f_ & (hiddenBit << 1)) )
+        {
+            plus.f_ <<= 1;
+            --plus.e_;
+        }
+        plus.f_ <<= 10;
+        plus.e_ -= 10;
+        minus = f_ == hiddenBit ? DiyFp( (f_ << 2) - 1, e_ - 2 )
+                                : DiyFp( (f_ << 1) - 1, e_ - 1 );
+        minus.f_ <<= minus.e_ - plus.e_;
+        minus.e_ = plus.e_;
+    }
+
+    enum { exponentBias = 0x3FF + 52 };
+    static const unsigned long long hiddenBit = 1ULL << 52;
+
+    unsigned long long f_;
+    int e_;
+};
+
+// Cached power of ten c_k with K = -k such that w * c_k has a binary
+// exponent in [-60, -32].
+static inline DiyFp cachedPower( int e, int &K )
+{
+    static const struct
+    {
+        unsigned long long f_;
+        int e_;
+    } powers[] =
+    {
+        { 0xfa8fd5a0081c0288ULL, -1220 }, // 1e-348
+        { 0xbaaee17fa23ebf76ULL, -1193 }, // 1e-340
+        { 0x8b16fb203055ac76ULL, -1166 }, // 1e-332
+        { 0xcf42894a5dce35eaULL, -1140 }, // 1e-324
+        { 0x9a6bb0aa55653b2dULL, -1113 }, // 1e-316
+        { 0xe61acf033d1a45dfULL, -1087 }, // 1e-308
+        { 0xab70fe17c79ac6caULL, -1060 }, // 1e-300
+        { 0xff77b1fcbebcdc4fULL, -1034 }, // 1e-292
+        { 0xbe5691ef416bd60cULL, -1007 }, // 1e-284
+        { 0x8dd01fad907ffc3cULL,  -980 }, // 1e-276
+        { 0xd3515c2831559a83ULL,  -954 }, // 1e-268
+        { 0x9d71ac8fada6c9b5ULL,  -927 }, // 1e-260
+        { 0xea9c227723ee8bcbULL,  -901 }, // 1e-252
+        { 0xaecc49914078536dULL,  -874 }, // 1e-244
+        { 0x823c12795db6ce57ULL,  -847 }, // 1e-236
+        { 0xc21094364dfb5637ULL,  -821 }, // 1e-228
+        { 0x9096ea6f3848984fULL,  -794 }, // 1e-220
+        { 0xd77485cb25823ac7ULL,  -768 }, // 1e-212
+        { 0xa086cfcd97bf97f4ULL,  -741 }, // 1e-204
+        { 0xef340a98172aace5ULL,  -715 }, // 1e-196
+        { 0xb23867fb2a35b28eULL,  -688 }, // 1e-188
+        { 0x84c8d4dfd2c63f3bULL,  -661 }, // 1e-180
+        { 0xc5dd44271ad3cdbaULL,  -635 }, // 1e-172
+        { 0x936b9fcebb25c996ULL,  -608 }, // 1e-164
+        { 0xdbac6c247d62a584ULL,  -582 }, // 1e-156
+        { 0xa3ab66580d5fdaf6ULL,  -555 }, // 1e-148
+        { 0xf3e2f893dec3f126ULL,  -529 }, // 1e-140
+        { 0xb5b5ada8aaff80b8ULL,  -502 }, // 1e-132
+        { 0x87625f056c7c4a8bULL,  -475 }, // 1e-124
+        { 0xc9bcff6034c13053ULL,  -449 }, // 1e-116
+        { 0x964e858c91ba2655ULL,  -422 }, // 1e-108
+        { 0xdff9772470297ebdULL,  -396 }, // 1e-100
+        { 0xa6dfbd9fb8e5b88fULL,  -369 }, // 1e-92
+        { 0xf8a95fcf88747d94ULL,  -343 }, // 1e-84
+        { 0xb94470938fa89bcfULL,  -316 }, // 1e-76
+        { 0x8a08f0f8bf0f156bULL,  -289 }, // 1e-68
+        { 0xcdb02555653131b6ULL,  -263 }, // 1e-60
+        { 0x993fe2c6d07b7facULL,  -236 }, // 1e-52
+        { 0xe45c10c42a2b3b06ULL,  -210 }, // 1e-44
+        { 0xaa242499697392d3ULL,  -183 }, // 1e-36
+        { 0xfd87b5f28300ca0eULL,  -157 }, // 1e-28
+        { 0xbce5086492111aebULL,  -130 }, // 1e-20
+        { 0x8cbccc096f5088ccULL,  -103 }, // 1e-12
+        { 0xd1b71758e219652cULL,   -77 }, // 1e-4
+        { 0x9c40000000000000ULL,   -50 }, // 1e4
+        { 0xe8d4a51000000000ULL,   -24 }, // 1e12
+        { 0xad78ebc5ac620000ULL,     3 }, // 1e20
+        { 0x813f3978f8940984ULL,    30 }, // 1e28
+        { 0xc097ce7bc90715b3ULL,    56 }, // 1e36
+        { 0x8f7e32ce7bea5c70ULL,    83 }, // 1e44
+        { 0xd5d238a4abe98068ULL,   109 }, // 1e52
+        { 0x9f4f2726179a2245ULL,   136 }, // 1e60
+        { 0xed63a231d4c4fb27ULL,   162 }, // 1e68
+        { 0xb0de65388cc8ada8ULL,   189 }, // 1e76
+        { 0x83c7088e1aab65dbULL,   216 }, // 1e84
+        { 0xc45d1df942711d9aULL,   242 }, // 1e92
+        { 0x924d692ca61be758ULL,   269 }, // 1e100
+        { 0xda01ee641a708deaULL,   295 }, // 1e108
+        { 0xa26da3999aef774aULL,   322 }, // 1e116
+        { 0xf209787bb47d6b85ULL,   348 }, // 1e124
+        { 0xb454e4a179dd1877ULL,   375 }, // 1e132
+        { 0x865b86925b9bc5c2ULL,   402 }, // 1e140
+        { 0xc83553c5c8965d3dULL,   428 }, // 1e148
+        { 0x952ab45cfa97a0b3ULL,   455 }, // 1e156
+        { 0xde469fbd99a05fe3ULL,   481 }, // 1e164
+        { 0xa59bc234db398c25ULL,   508 }, // 1e172
+        { 0xf6c69a72a3989f5cULL,   534 }, // 1e180
+        { 0xb7dcbf5354e9beceULL,   561 }, // 1e188
+        { 0x88fcf317f22241e2ULL,   588 }, // 1e196
+        { 0xcc20ce9bd35c78a5ULL,   614 }, // 1e204
+        { 0x98165af37b2153dfULL,   641 }, // 1e212
+        { 0xe2a0b5dc971f303aULL,   667 }, // 1e220
+        { 0xa8d9d1535ce3b396ULL,   694 }, // 1e228
+        { 0xfb9b7cd9a4a7443cULL,   720 }, // 1e236
+        { 0xbb764c4ca7a44410ULL,   747 }, // 1e244
+        { 0x8bab8eefb6409c1aULL,   774 }, // 1e252
+        { 0xd01fef10a657842cULL,   800 }, // 1e260
+        { 0x9b10a4e5e9913129ULL,   827 }, // 1e268
+        { 0xe7109bfba19c0c9dULL,   853 }, // 1e276
+        { 0xac2820d9623bf429ULL,   880 }, // 1e284
+        { 0x80444b5e7aa7cf85ULL,   907 }, // 1e292
+        { 0xbf21e44003acdd2dULL,   933 }, // 1e300
+        { 0x8e679c2f5e44ff8fULL,   960 }, // 1e308
+        { 0xd433179d9c8cb841ULL,   986 }, // 1e316
+        { 0x9e19db92b4e31ba9ULL,  1013 }, // 1e324
+        { 0xeb96bf6ebadf77d9ULL,  1039 }, // 1e332
+        { 0xaf87023b9bf0ee6bULL,  1066 }  // 1e340
+    };
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int k = int( dk );
+    if ( k != dk )
+    {
+        ++k;
+    }
+    unsigned int index = unsigned( (k >> 3) + 1 );
+    K = -(-348 + int( index << 3 ));
+    return DiyFp( powers[index].f_, powers[index].e_ );
+}
+
+static inline void grisuRound( char *buffer, 
+                               int length, 
+                               unsigned long long delta, 
+                               unsigned long long rest, 
+                               unsigned long long tenKappa, 
+                               unsigned long long distance )
+{
+    while ( rest < distance  &&  delta - rest >= tenKappa
+            &&  (rest + tenKappa < distance  ||  distance - rest > rest + tenKappa - distance) )
+    {
+        --buffer[length - 1];
+        rest += tenKappa;
+    }
+}
+
+static inline int decimalDigitCount( unsigned int n )
+{
+    int count = 1;
+    while ( n >= 10 )
+    {
+        n /= 10;
+        ++count;
+    }
+    return count;
+}
+
+static inline void digitGen( const DiyFp &w, 
+                             const DiyFp &upper, 
+                             unsigned long long delta, 
+                             char *buffer, 
+                             int &length, 
+                             int &K )
+{
+    static const unsigned long long powersOfTen[] =
+    {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 
+        10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL, 
+        100000000000ULL, 1000000000000ULL, 10000000000000ULL, 
+        100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 
+        100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+    };
+    const DiyFp one( 1ULL << -upper.e_, upper.e_ );
+    const DiyFp distance = upper - w;
+    unsigned int integral = unsigned( upper.f_ >> -one.e_ );
+    unsigned long long fractional = upper.f_ & (one.f_ - 1);
+    int kappa = decimalDigitCount( integral );
+    length = 0;
+
+    while ( kappa > 0 )
+    {
+        unsigned int divisor = unsigned( powersOfTen[kappa - 1] );
+        unsigned int digit = integral / divisor;
+        integral %= divisor;
+        if ( digit  ||  length )
+        {
+            buffer[length++] = char( '0' + digit );
+        }
+        --kappa;
+        unsigned long long rest = ((unsigned long long)integral << -one.e_) + fractional;
+        if ( rest <= delta )
+        {
+            K += kappa;
+            grisuRound( buffer, length, delta, rest, powersOfTen[kappa] << -one.e_, distance.f_ );
+            return;
+        }
+    }
+
+    for (;;)
+    {
+        fractional *= 10;
+        delta *= 10;
+        char digit = char( fractional >> -one.e_ );
+        if ( digit  ||  length )
+        {
+            buffer[length++] = char( '0' + digit );
+        }
+        fractional &= one.f_ - 1;
+        --kappa;
+        if ( fractional < delta )
+        {
+            K += kappa;
+            grisuRound( buffer, length, delta, fractional, one.f_, 
+                        -kappa < 20 ? distance.f_ * powersOfTen[-kappa] : 0 );
+            return;
+        }
+    }
+}
+
+// Writes the digits of a finite, positive value to buffer; the value is
+// digits * 10^K.
+static inline void grisu2( double value, char *buffer, int &length, int &K )
+{
+    const DiyFp v( value );
+    DiyFp minus, plus;
+    v.normalizedBoundaries( minus, plus );
+    const DiyFp cached = cachedPower( plus.e_, K );
+    const DiyFp w = v.normalize() * cached;
+    DiyFp upper = plus * cached;
+    DiyFp lower = minus * cached;
+    ++lower.f_;
+    --upper.f_;
+    digitGen( w, upper, upper.f_ - lower.f_, buffer, length, K );
+}
+
+// Formats a finite double into buffer (at least 32 bytes) and returns the
+// end of the text. Integral values keep a ".0" so they read back as reals;
+// magnitudes outside [1e-5, 1e17) use an exponent.
+static inline char *formatDouble( double value, char *buffer )
+{
+    if ( value < 0  ||  (value == 0  &&  1 / value < 0) )
+    {
+        *buffer++ = '-';
+        value = -value;
+    }
+    if ( value == 0 )
+    {
+        memcpy( buffer, "0.0", 3 );
+        return buffer + 3;
+    }
+
+    char digits[24];
+    int length, K;
+    grisu2( value, digits, length, K );
+    int point = length + K; // position of the decimal point from the first digit
+
+    if ( point > 0  &&  point <= 17 )
+    {
+        if ( K >= 0 )
+        {
+            memcpy( buffer, digits, length );
+            buffer += length;
+            memset( buffer, '0', K );
+            buffer += K;
+            memcpy( buffer, ".0", 2 );
+            return buffer + 2;
+        }
+        memcpy( buffer, digits, point );
+        buffer += point;
+        *buffer++ = '.';
+        memcpy( buffer, digits + point, length - point );
+        return buffer + length - point;
+    }
+    if ( point <= 0  &&  point > -5 )
+    {
+        memcpy( buffer, "0.", 2 );
+        buffer += 2;
+        memset( buffer, '0', -point );
+        buffer += -point;
+        memcpy( buffer, digits, length );
+        return buffer + length;
+    }
+
+    *buffer++ = digits[0];
+    if ( length > 1 )
+    {
+        *buffer++ = '.';
+        memcpy( buffer, digits + 1, length - 1 );
+        buffer += length - 1;
+    }
+    *buffer++ = 'e';
+    int exponent = point - 1;
+    if ( exponent < 0 )
+    {
+        *buffer++ = '-';
+        exponent = -exponent;
+    }
+    else
+    {
+        *buffer++ = '+';
+    }
+    if ( exponent >= 100 )
+    {
+        *buffer++ = char( '0' + exponent / 100 );
+        exponent %= 100;
+        *buffer++ = char( '0' + exponent / 10 );
+    }
+    else if ( exponent >= 10 )
+    {
+        *buffer++ = char( '0' + exponent / 10 );
+    }
+    *buffer++ = char( '0' + exponent % 10 );
+    return buffer;
+}
+
+} // namespace Json
+
+#endif // JSONCPP_DTOA_H_INCLUDED
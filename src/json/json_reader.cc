@@ -1,7 +1,13 @@
 #include "reader.h"
 #include "value.h"
+#include "tape.h"
+#include "json_scanner.h"
+#include "json_powers.h"
 #include <utility>
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <clocale>
 #include <cassert>
 #include <cstring>
 #include <iostream>
@@ -26,6 +32,7 @@ in( Reader::Char c, Reader::Char c1, Reader::Char c2, Reader::Char c3, Reader::C
 }
 
 
+# ifndef JSON_NO_COMMENTS
 static bool 
 containsNewLine( Reader::Location begin, 
                       Reader::Location end )
@@ -40,116 +47,1187 @@ containsNewLine( Reader::Location begin,
         
      return false;
 }
+# endif
+
+static Reader::Char *
+codePointToUTF8( unsigned int cp, Reader::Char *output )
+{
+    if (cp <= 0x7f) 
+    {
+        *output++ = static_cast<Reader::Char>( cp );
+    } 
+    else if (cp <= 0x7FF) 
+    {
+        *output++ = static_cast<Reader::Char>( 0xC0 | (0x1f & (cp >> 6)) );
+        *output++ = static_cast<Reader::Char>( 0x80 | (0x3f & cp) );
+    } 
+    else if (cp <= 0xFFFF) 
+    {
+        *output++ = static_cast<Reader::Char>( 0xE0 | (0xf & (cp >> 12)) );
+        *output++ = static_cast<Reader::Char>( 0x80 | (0x3f & (cp >> 6)) );
+        *output++ = static_cast<Reader::Char>( 0x80 | (0x3f & cp) );
+    }
+    else
+    {
+        *output++ = static_cast<Reader::Char>( 0xF0 | (0x7 & (cp >> 18)) );
+        *output++ = static_cast<Reader::Char>( 0x80 | (0x3f & (cp >> 12)) );
+        *output++ = static_cast<Reader::Char>( 0x80 | (0x3f & (cp >> 6)) );
+        *output++ = static_cast<Reader::Char>( 0x80 | (0x3f & cp) );
+    }
+    return output;
+}
+
+
+// Number token split into at most 19 significant digits and a power of ten.
+struct DecimalNumber
+{
+    unsigned long long mantissa_;
+    int exponent_;
+    bool negative_;
+    bool truncated_;  // non-zero digits were dropped from mantissa_
+};
+
+// Messages are only built when getFormatedErrorMessages() asks for them.
+static const char *
+errorMessage( Reader::ErrorCode code )
+{
+    switch ( code )
+    {
+    case Reader::errorValueExpected:
+        return "Syntax error: value, object or array expected.";
+    case Reader::errorMissingObjectEnd:
+        return "Missing ',' or '}' in object declaration";
+    case Reader::errorMissingArrayEnd:
+        return "Missing ',' or ']' in array declaration";
+    case Reader::errorMissingMemberName:
+        return "Missing '}' or object member name";
+    case Reader::errorMissingColon:
+        return "Missing ':' after object member name";
+    case Reader::errorEmptyEscape:
+        return "Empty escape sequence in string";
+    case Reader::errorBadEscape:
+        return "Bad escape sequence in string";
+    case Reader::errorSurrogateTooShort:
+        return "additional six characters expected to parse unicode surrogate pair.";
+    case Reader::errorSurrogateExpected:
+        return "expecting another \\u token to begin the second half of a unicode surrogate pair";
+    case Reader::errorUnicodeTooShort:
+        return "Bad unicode escape sequence in string: four digits expected.";
+    case Reader::errorUnicodeDigit:
+        return "Bad unicode escape sequence in string: hexadecimal digit expected.";
+    case Reader::errorStackLimit:
+        return "Arrays and objects nested deeper than the stack limit";
+    case Reader::errorStoppedByHandler:
+        return "Parsing stopped by the handler.";
+    case Reader::errorExtraData:
+        return "Extra data after the root value.";
+    case Reader::errorDocumentTooLarge:
+        return "Document too large to index";
+    default:
+        return "";
+    }
+}
+
+
+static inline bool 
+isDigit( Reader::Char c )
+{
+     return c >= '0'  &&  c <= '9';
+}
+
+static bool 
+splitDecimal( Reader::Location current, 
+              Reader::Location end, 
+              DecimalNumber &number )
+{
+    const int maxDigits = 19;
+    int digits = 0;
+    bool hasDigits = false;
+    number.mantissa_ = 0;
+    number.exponent_ = 0;
+    number.truncated_ = false;
+    number.negative_ = current != end  &&  *current == '-';
+    if ( number.negative_ )
+    {
+        ++current;
+    }
+
+    for ( ; current != end  &&  isDigit( *current ); ++current )
+    {
+        hasDigits = true;
+        if ( digits < maxDigits )
+        {
+            number.mantissa_ = number.mantissa_ * 10 + (*current - '0');
+            digits += number.mantissa_ != 0;
+        }
+        else
+        {
+            ++number.exponent_;
+            number.truncated_ = number.truncated_  ||  *current != '0';
+        }
+    }
+    if ( current != end  &&  *current == '.' )
+    {
+        for ( ++current; current != end  &&  isDigit( *current ); ++current )
+        {
+            hasDigits = true;
+            if ( digits < maxDigits )
+            {
+                number.mantissa_ = number.mantissa_ * 10 + (*current - '0');
+                digits += number.mantissa_ != 0;
+                --number.exponent_;
+            }
+            else
+            {
+                number.truncated_ = number.truncated_  ||  *current != '0';
+            }
+        }
+    }
+    if ( !hasDigits )
+    {
+        return false;
+    }
+
+    if ( current != end  &&  (*current == 'e'  ||  *current == 'E') )
+    {
+        ++current;
+        bool negativeExponent = current != end  &&  *current == '-';
+        if ( current != end  &&  (*current == '-'  ||  *current == '+') )
+        {
+            ++current;
+        }
+        if ( current == end )
+        {
+            return false;
+        }
+        int exponent = 0;
+        for ( ; current != end  &&  isDigit( *current ); ++current )
+        {
+            if ( exponent < 100000 )
+            {
+                exponent = exponent * 10 + (*current - '0');
+            }
+        }
+        number.exponent_ += negativeExponent ? -exponent : exponent;
+    }
+    return current == end;
+}
+
+static inline int 
+leadingZeros( unsigned long long value )
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64( &index, value );
+    return 63 - int(index);
+#elif defined(__GNUC__)
+    return __builtin_clzll( value );
+#else
+    int count = 0;
+    for ( ; !(value & (1ULL << 63)); value <<= 1 )
+    {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+static inline void 
+multiply64( unsigned long long a, 
+            unsigned long long b, 
+            unsigned long long &high, 
+            unsigned long long &low )
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = (unsigned __int128)a * b;
+    high = (unsigned long long)(product >> 64);
+    low = (unsigned long long)product;
+#elif defined(_MSC_VER) && defined(_M_X64)
+    low = _umul128( a, b, &high );
+#else
+    unsigned long long aLow = a & 0xffffffff, aHigh = a >> 32;
+    unsigned long long bLow = b & 0xffffffff, bHigh = b >> 32;
+    unsigned long long lowLow = aLow * bLow;
+    unsigned long long highLow = aHigh * bLow;
+    unsigned long long lowHigh = aLow * bHigh;
+    unsigned long long middle = (lowLow >> 32) + (highLow & 0xffffffff) + lowHigh;
+    high = aHigh * bHigh + (highLow >> 32) + (middle >> 32);
+    low = (middle << 32) | (lowLow & 0xffffffff);
+#endif
+}
+
+// Eisel-Lemire: multiplies the mantissa by a 128-bit approximation of
+// 5^exponent and rounds the result. Returns false when the truncated
+// product cannot decide the rounding, which the caller resolves by
+// falling back to strtod.
+static bool 
+eiselLemire( unsigned long long mantissa, 
+             int exponent, 
+             double &value )
+{
+    if ( exponent < smallestPowerOfFive  ||  exponent > largestPowerOfFive )
+    {
+        return false;
+    }
+    const unsigned long long *power = powersOfFive[exponent - smallestPowerOfFive];
+    int shift = leadingZeros( mantissa );
+    mantissa <<= shift;
+
+    unsigned long long upper, lower;
+    multiply64( mantissa, power[0], upper, lower );
+    if ( (upper & 0x1FF) == 0x1FF  &&  lower + mantissa < lower )
+    {
+        unsigned long long lowUpper, lowLower;
+        multiply64( mantissa, power[1], lowUpper, lowLower );
+        lower += lowUpper;
+        if ( lower < lowUpper )
+        {
+            ++upper;
+        }
+        if ( lower + 1 == 0  &&  (upper & 0x1FF) == 0x1FF  &&  lowLower + mantissa < lowLower )
+        {
+            return false;
+        }
+    }
+
+    unsigned long long upperBit = upper >> 63;
+    unsigned long long significand = upper >> (upperBit + 9);
+    shift += int(1 ^ upperBit);
+    if ( lower == 0  &&  (upper & 0x1FF) == 0  &&  (significand & 3) == 1 )
+    {
+        return false; // may lie exactly halfway between two doubles
+    }
+    significand += significand & 1;
+    significand >>= 1;
+    if ( significand >= (1ULL << 53) )
+    {
+        significand = 1ULL << 52;
+        --shift;
+    }
+    significand &= ~(1ULL << 52);
+
+    long long biasedExponent = (((152170 + 65536) * exponent) >> 16) + 1024 + 63 - shift;
+    if ( biasedExponent < 1  ||  biasedExponent > 2046 )
+    {
+        return false; // subnormal or overflow
+    }
+    significand |= (unsigned long long)biasedExponent << 52;
+    memcpy( &value, &significand, sizeof(value) );
+    return true;
+}
+
+static bool 
+decimalToDouble( const DecimalNumber &number, double &value )
+{
+    static const double powersOfTen[] = 
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    if ( number.mantissa_ == 0 )
+    {
+        value = 0;
+    }
+    else if ( number.truncated_ )
+    {
+        // The exact value lies between mantissa and mantissa + 1 units.
+        double upper;
+        if ( !eiselLemire( number.mantissa_, number.exponent_, value )
+             ||  !eiselLemire( number.mantissa_ + 1, number.exponent_, upper )
+             ||  value != upper )
+        {
+            return false;
+        }
+    }
+    else if ( number.mantissa_ <= (1ULL << 53)  
+              &&  number.exponent_ >= -22  &&  number.exponent_ <= 22 )
+    {
+        // Both operands are exact, so a single IEEE operation rounds correctly.
+        value = double(number.mantissa_);
+        if ( number.exponent_ < 0 )
+        {
+            value /= powersOfTen[-number.exponent_];
+        }
+        else
+        {
+            value *= powersOfTen[number.exponent_];
+        }
+    }
+    else if ( !eiselLemire( number.mantissa_, number.exponent_, value ) )
+    {
+        return false;
+    }
+
+    if ( number.negative_ )
+    {
+        value = -value;
+    }
+    return true;
+}
+
+// strtod honours the C locale decimal point, so '.' is swapped for it
+// before conversion.
+static double 
+stringToDouble( Reader::Location begin, 
+                Reader::Location end )
+{
+    const int bufferSize = 64;
+    Reader::Char stackBuffer[bufferSize];
+    std::string heapBuffer;
+    int length = int(end - begin);
+    Reader::Char *buffer = stackBuffer;
+    if ( length >= bufferSize )
+    {
+        heapBuffer.assign( begin, end );
+        buffer = &heapBuffer[0];
+    }
+    else
+    {
+        memcpy( buffer, begin, length );
+        buffer[length] = 0;
+    }
+
+    Reader::Char decimalPoint = *localeconv()->decimal_point;
+    if ( decimalPoint != '.' )
+    {
+        std::replace( buffer, buffer + length, '.', decimalPoint );
+    }
+    return strtod( buffer, 0 );
+}
+
+
+ReaderHandler::~ReaderHandler()
+{
+}
+
+bool 
+ReaderHandler::onNull()
+{
+    return true;
+}
+
+bool 
+ReaderHandler::onBool( bool )
+{
+    return true;
+}
+
+bool 
+ReaderHandler::onInt( Value::LargestInt )
+{
+    return true;
+}
+
+bool 
+ReaderHandler::onUInt( Value::LargestUInt )
+{
+    return true;
+}
+
+bool 
+ReaderHandler::onDouble( double )
+{
+    return true;
+}
+
+bool 
+ReaderHandler::onString( const char *, unsigned int )
+{
+    return true;
+}
+
+bool 
+ReaderHandler::onStartObject()
+{
+    return true;
+}
+
+bool 
+ReaderHandler::onKey( const char *, unsigned int )
+{
+    return true;
+}
+
+bool 
+ReaderHandler::onEndObject()
+{
+    return true;
+}
+
+bool 
+ReaderHandler::onStartArray()
+{
+    return true;
+}
+
+bool 
+ReaderHandler::onEndArray()
+{
+    return true;
+}
 
 
 Reader::Reader()
+    : insitu_( false )
+    , indexing_( false )
+    , allocator_( 0 )
+    , memberNames_( 0 )
+    , stackLimit_( defaultStackLimit )
+    , strict_( false )
 {
 }
 
-bool
-Reader::parse( const std::string &document, 
-                    Value &root,
-                    bool collectComments )
+void 
+Reader::setAllocator( ValueAllocator *allocator )
+{
+    allocator_ = allocator;
+}
+
+void 
+Reader::setMemberNameTable( MemberNameTable *table )
+{
+    memberNames_ = table;
+}
+
+void 
+Reader::setStackLimit( unsigned int limit )
+{
+    stackLimit_ = limit;
+}
+
+void 
+Reader::setStrictMode( bool strict )
+{
+    strict_ = strict;
+}
+
+bool
+Reader::parse( const std::string &document, 
+                    Value &root,
+                    bool collectComments )
+{
+    document_ = document;
+    const char *begin = document_.c_str();
+    const char *end = begin + document_.length();
+    return parse( begin, end, root, collectComments );
+}
+
+bool
+Reader::parse( std::istream& sin,
+                    Value &root,
+                    bool collectComments )
+{
+    std::string doc;
+    std::getline(sin, doc, (char)EOF);
+    return parse( doc, root, collectComments );
+}
+
+bool 
+Reader::parse( const char *beginDoc, const char *endDoc, 
+                    Value &root,
+                    bool collectComments )
+{
+    insitu_ = false;
+    return readDocument( beginDoc, endDoc, root, collectComments );
+}
+
+bool 
+Reader::parseInsitu( char *beginDoc, char *endDoc, 
+                          Value &root,
+                          bool collectComments )
+{
+    insitu_ = true;
+    return readDocument( beginDoc, endDoc, root, collectComments );
+}
+
+bool 
+Reader::readDocument( const char *beginDoc, const char *endDoc, 
+                            Value &root,
+                            bool collectComments )
+{
+    begin_ = beginDoc;
+    end_ = endDoc;
+# ifdef JSON_NO_COMMENTS
+    collectComments_ = false;
+# else
+    collectComments_ = collectComments  &&  !strict_;
+# endif
+    current_ = begin_;
+    lastValueEnd_ = 0;
+    lastValue_ = 0;
+    commentsBefore_ = "";
+    errors_.clear();
+
+    nodes_.clear();
+    pushNode( &root, tokenEndOfStream );
+    
+    bool successful = readValue();
+    if ( strict_ )
+    {
+        return successful  &&  expectEndOfStream();
+    }
+    Token token;
+    
+    skipCommentTokens( token );
+    
+# ifndef JSON_NO_COMMENTS
+    if (collectComments_  &&  !commentsBefore_.empty())
+    {
+         root.setComment(commentsBefore_, commentAfter);
+    }
+# endif
+
+    return successful;
+}
+
+
+// Reads the value of the node on top of nodes_ without recursing: an
+// array or object pushes a node for each element, and the loop returns
+// to the container once that element is complete. A failed element makes
+// each enclosing container skip to its closing token in turn.
+bool
+Reader::readValue()
+{
+    const Nodes::size_type base = nodes_.size();
+    while ( true )
+    {
+        Token token;
+        skipCommentTokens( token );
+
+# ifndef JSON_NO_COMMENTS
+        if ( collectComments_  &&  !commentsBefore_.empty() )
+        {
+            currentValue().setComment( commentsBefore_, commentBefore );
+            commentsBefore_ = "";
+        }
+# endif
+
+        Step step = stepEndValue;
+        bool markValue = true;
+        switch ( token.type_ )
+        {
+        case tokenObjectBegin:
+            step = beginObject( token );
+            break;
+        case tokenArrayBegin:
+            step = beginArray( token );
+            break;
+        case tokenNumber:
+            step = decodeNumber( token ) ? stepEndValue : stepError;
+            break;
+        case tokenString:
+            step = decodeString( token ) ? stepEndValue : stepError;
+            break;
+        case tokenTrue:
+            currentValue() = true;
+            break;
+        case tokenFalse:
+            currentValue() = false;
+            break;
+        case tokenNull:
+            currentValue() = Value();
+            break;
+        default:
+            addError( errorValueExpected, token );
+            step = stepError;
+            markValue = false;
+            break;
+        }
+
+        while ( step != stepReadValue )
+        {
+            // Members are appended as read and sorted once the object is
+            // complete, which keeps building it O(n log n).
+            if ( nodes_.back().closer_ == tokenObjectEnd  &&  currentValue().sortMembers() )
+            {
+                lastValue_ = &currentValue();
+            }
+            if ( collectComments_  &&  markValue )
+            {
+                lastValueEnd_ = current_;
+                lastValue_ = &currentValue();
+            }
+            markValue = true;
+            if ( nodes_.size() == base  ||  (step == stepError  &&  strict_) )
+            {
+                return step == stepEndValue;
+            }
+            nodes_.pop_back();
+            if ( step == stepError )
+            {
+                recoverFromError( nodes_.back().closer_ );
+                continue;
+            }
+            step = nodes_.back().closer_ == tokenObjectEnd ? readObjectSeparator()
+                                                           : readArraySeparator();
+        }
+    }
+}
+
+
+bool 
+Reader::parse( const char *beginDoc, const char *endDoc, 
+                    ReaderHandler &handler )
+{
+    begin_ = beginDoc;
+    end_ = endDoc;
+    collectComments_ = false;
+    insitu_ = false;
+    current_ = begin_;
+    lastValueEnd_ = 0;
+    lastValue_ = 0;
+    commentsBefore_ = "";
+    errors_.clear();
+
+    return readValue( handler )  &&  ( !strict_  ||  expectEndOfStream() );
+}
+
+
+// Same traversal as readValue(), reporting to handler instead of building
+// values; any error ends the parse.
+bool
+Reader::readValue( ReaderHandler &handler )
+{
+    nodes_.clear();
+    while ( true )
+    {
+        Token token;
+        skipCommentTokens( token );
+        bool successful = true;
+
+        switch ( token.type_ )
+        {
+        case tokenObjectBegin:
+            if ( nodes_.size() >= stackLimit_ )
+            {
+                return addStackLimitError( token );
+            }
+            if (!handler.onStartObject())
+            {
+                 return addHandlerError(token);
+            }
+            pushNode( 0, tokenObjectEnd );
+            skipCommentTokens( token );
+            if (token.type_ != tokenObjectEnd)
+            {
+                if (!readObjectMember(token, handler))
+                {
+                     return false;
+                }
+                continue;
+            }
+            nodes_.pop_back();
+            successful = handler.onEndObject();
+            break;
+        case tokenArrayBegin:
+            if ( nodes_.size() >= stackLimit_ )
+            {
+                return addStackLimitError( token );
+            }
+            if (!handler.onStartArray())
+            {
+                 return addHandlerError(token);
+            }
+            skipSpaces();
+            if ( current_ == end_  ||  *current_ != ']' )
+            {
+                pushNode( 0, tokenArrayEnd );
+                continue;
+            }
+            readToken( token );
+            successful = handler.onEndArray();
+            break;
+        case tokenNumber:
+            {
+                Value decoded;
+                if (!decodeNumber(token, decoded))
+                {
+                     return false;
+                }
+                switch ( decoded.type() )
+                {
+                case intValue:
+                    successful = handler.onInt( decoded.asLargestInt() );
+                    break;
+                case uintValue:
+                    successful = handler.onUInt( decoded.asLargestUInt() );
+                    break;
+                default:
+                    successful = handler.onDouble( decoded.asDouble() );
+                    break;
+                }
+            }
+            break;
+        case tokenString:
+            if (!decodeString(token, decodedString_))
+            {
+                 return false;
+            }
+            successful = handler.onString( decodedString_.data(), 
+                                           (unsigned int)decodedString_.length() );
+            break;
+        case tokenTrue:
+            successful = handler.onBool( true );
+            break;
+        case tokenFalse:
+            successful = handler.onBool( false );
+            break;
+        case tokenNull:
+            successful = handler.onNull();
+            break;
+        default:
+            return addError( errorValueExpected, token );
+        }
+        if (!successful)
+        {
+             return addHandlerError( token );
+        }
+
+        // The value is complete: close the containers it ends, up to the
+        // next element.
+        while ( !nodes_.empty() )
+        {
+            TokenType closer = nodes_.back().closer_;
+            skipCommentTokens( token );
+            if (token.type_ == closer)
+            {
+                nodes_.pop_back();
+                successful = closer == tokenObjectEnd ? handler.onEndObject() 
+                                                      : handler.onEndArray();
+                if (!successful)
+                {
+                     return addHandlerError( token );
+                }
+                continue;
+            }
+            if (token.type_ != tokenArraySeparator)
+            {
+                return addError( closer == tokenObjectEnd ? errorMissingObjectEnd : errorMissingArrayEnd, 
+                                 token );
+            }
+            if ( closer == tokenObjectEnd )
+            {
+                skipCommentTokens( token );
+                if (!readObjectMember(token, handler))
+                {
+                     return false;
+                }
+            }
+            break;
+        }
+        if ( nodes_.empty() )
+        {
+            return true;
+        }
+    }
+}
+
+
+// Reports the member name in tokenName and reads the ':' after it.
+bool 
+Reader::readObjectMember( Token &tokenName, ReaderHandler &handler )
+{
+    if (tokenName.type_ != tokenString)
+    {
+         return addError( errorMissingMemberName, tokenName );
+    }
+    if (!decodeString(tokenName, decodedString_))
+    {
+         return false;
+    }
+    if (!handler.onKey(decodedString_.data(), (unsigned int)decodedString_.length()))
+    {
+         return addHandlerError(tokenName);
+    }
+
+    Token colon;
+    if ( !readToken( colon ) ||  colon.type_ != tokenMemberSeparator )
+    {
+        return addError( errorMissingColon, colon );
+    }
+    return true;
+}
+
+
+bool 
+Reader::parse( const char *beginDoc, const char *endDoc, 
+                    Tape &tape )
+{
+    begin_ = beginDoc;
+    end_ = endDoc;
+    collectComments_ = false;
+    insitu_ = false;
+    current_ = begin_;
+    lastValueEnd_ = 0;
+    lastValue_ = 0;
+    commentsBefore_ = "";
+    errors_.clear();
+
+    tape.entries_.clear();
+    tape.begin_ = beginDoc;
+    tape.end_ = endDoc;
+    if ( size_t(endDoc - beginDoc) >= size_t(unsigned(-1)) )
+    {
+        Token token;
+        token.type_ = tokenError;
+        token.start_ = token.end_ = beginDoc;
+        return addError( errorDocumentTooLarge, token );
+    }
+    if ( startIndex()  &&  readIndexedValue( tape ) )
+    {
+        return true;
+    }
+    indexing_ = false;
+    current_ = begin_;
+    tape.entries_.clear();
+    bool successful = readValue( tape )  &&  ( !strict_  ||  expectEndOfStream() );
+    if ( !successful )
+    {
+        tape.entries_.clear();
+    }
+    return successful;
+}
+
+
+// Same traversal as readValue( handler ). Each value and member name gets
+// an entry; an array or object is patched on its closing bracket to skip
+// to the entry after it.
+bool
+Reader::readValue( Tape &tape )
+{
+    nodes_.clear();
+    while ( true )
+    {
+        Token token;
+        skipCommentTokens( token );
+        addTapeEntry( tape, token.start_ );
+
+        switch ( token.type_ )
+        {
+        case tokenObjectBegin:
+        case tokenArrayBegin:
+            if ( nodes_.size() >= stackLimit_ )
+            {
+                return addStackLimitError( token );
+            }
+            pushNode( 0, token.type_ == tokenObjectBegin ? tokenObjectEnd : tokenArrayEnd );
+            nodes_.back().index_ = Value::ArrayIndex( tape.entries_.size() - 1 );
+            if ( token.type_ == tokenObjectBegin )
+            {
+                skipCommentTokens( token );
+                if ( token.type_ != tokenObjectEnd )
+                {
+                    if ( !readObjectMember( token, tape ) )
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+            }
+            else
+            {
+                skipSpaces();
+                if ( current_ == end_  ||  *current_ != ']' )
+                {
+                    continue;
+                }
+                readToken( token );
+            }
+            nodes_.pop_back();
+            break;
+        case tokenString:
+        case tokenNumber:
+        case tokenTrue:
+        case tokenFalse:
+        case tokenNull:
+            break;
+        default:
+            return addError( errorValueExpected, token );
+        }
+
+        // The value is complete: close the containers it ends, up to the
+        // next element.
+        while ( !nodes_.empty() )
+        {
+            Node &node = nodes_.back();
+            skipCommentTokens( token );
+            if ( token.type_ == node.closer_ )
+            {
+                tape.entries_[node.index_].next_ = (unsigned int)tape.entries_.size();
+                nodes_.pop_back();
+                continue;
+            }
+            if ( token.type_ != tokenArraySeparator )
+            {
+                return addError( node.closer_ == tokenObjectEnd ? errorMissingObjectEnd : errorMissingArrayEnd, 
+                                 token );
+            }
+            if ( node.closer_ == tokenObjectEnd )
+            {
+                skipCommentTokens( token );
+                if ( !readObjectMember( token, tape ) )
+                {
+                    return false;
+                }
+            }
+            break;
+        }
+        if ( nodes_.empty() )
+        {
+            return true;
+        }
+    }
+}
+
+
+bool 
+Reader::readObjectMember( Token &tokenName, Tape &tape )
 {
-    document_ = document;
-    const char *begin = document_.c_str();
-    const char *end = begin + document_.length();
-    return parse( begin, end, root, collectComments );
+    if ( tokenName.type_ != tokenString )
+    {
+        return addError( errorMissingMemberName, tokenName );
+    }
+    addTapeEntry( tape, tokenName.start_ );
+
+    Token colon;
+    if ( !readToken( colon ) ||  colon.type_ != tokenMemberSeparator )
+    {
+        return addError( errorMissingColon, colon );
+    }
+    return true;
 }
 
-bool
-Reader::parse( std::istream& sin,
-                    Value &root,
-                    bool collectComments )
+
+// Large documents are structurally indexed first, a window at a time (see
+// indexStructurals()), for SSE2 targets only.
+static const size_t indexWindowSize = 16384;
+
+
+bool 
+Reader::startIndex()
 {
-    std::string doc;
-    std::getline(sin, doc, (char)EOF);
-    return parse( doc, root, collectComments );
+    indexing_ = false;
+# ifdef JSON_SCANNER_USE_SSE2
+    if ( size_t(end_ - begin_) >= indexWindowSize )
+    {
+        indexing_ = true;
+        structurals_.resize( indexWindowSize + 7 );
+        structural_ = 0;
+        structuralCount_ = 0;
+        indexed_ = begin_;
+        indexCarries_ = structuralSeparated;
+    }
+# endif
+    return indexing_;
 }
 
+
+// Indexes the windows after the current one until one holds a position.
+// Returns false at the end of the document and once indexing has been
+// given up.
 bool 
-Reader::parse( const char *beginDoc, const char *endDoc, 
-                    Value &root,
-                    bool collectComments )
+Reader::indexNextWindow()
 {
-    begin_ = beginDoc;
-    end_ = endDoc;
-    collectComments_ = collectComments;
-    current_ = begin_;
-    lastValueEnd_ = 0;
-    lastValue_ = 0;
-    commentsBefore_ = "";
-    errors_.clear();
-
-    while (!nodes_.empty())
+# ifdef JSON_SCANNER_USE_SSE2
+    while ( structural_ == structuralCount_ )
     {
-         nodes_.pop();
+        if ( !indexing_  ||  indexed_ == end_ )
+        {
+            return false;
+        }
+        Location windowEnd = size_t(end_ - indexed_) > indexWindowSize ? indexed_ + indexWindowSize : end_;
+        unsigned int *indexEnd = indexStructurals( begin_, indexed_, windowEnd, indexCarries_, &structurals_[0] );
+        indexing_ = indexEnd != 0;
+        structural_ = 0;
+        structuralCount_ = indexing_ ? indexEnd - &structurals_[0] : 0;
+        indexed_ = windowEnd;
     }
-    
-    nodes_.push( &root );
-    
-    bool successful = readValue();
-    Token token;
-    
-    skipCommentTokens( token );
-    
-    if (collectComments_  &&  !commentsBefore_.empty())
+    return true;
+# else
+    return false;
+# endif
+}
+
+
+// Called once per position, so it is kept inline; only readIndexedValue()
+// and readIndexedMember(), below, use it.
+inline bool 
+Reader::nextStructural( Location &position )
+{
+    if ( structural_ == structuralCount_  &&  !indexNextWindow() )
     {
-         root.setComment(commentsBefore_, commentAfter);
+        return false;
     }
+    position = begin_ + structurals_[structural_++];
+    return true;
+}
 
-    return successful;
+
+// A literal, number or string must be followed by a space, a separator,
+// a closing bracket or the end of the document; only the first byte of
+// each value is indexed, so this is checked on the document.
+bool 
+Reader::endsIndexedValue( Location location ) const
+{
+    return location == end_  ||  isJsonSpace( *location )
+           ||  *location == ','  ||  *location == ']'  ||  *location == '}';
 }
 
 
-bool
-Reader::readValue()
+bool 
+Reader::matchIndexed( Location location, const char *literal, int length ) const
 {
-    Token token;
-    skipCommentTokens( token );
-    bool successful = true;
+    return end_ - location >= length  &&  memcmp( location, literal, length ) == 0
+           &&  endsIndexedValue( location + length );
+}
+
 
-    if ( collectComments_  &&  !commentsBefore_.empty() )
+// Stage two of the structural index: builds the tape straight from the
+// indexed positions, with no tokenizer. It gives up on anything it does
+// not expect, every error included, and parse() then reads the document
+// token by token, which reports errors exactly as before.
+bool 
+Reader::readIndexedValue( Tape &tape )
+{
+    nodes_.clear();
+    while ( true )
     {
-        currentValue().setComment( commentsBefore_, commentBefore );
-        commentsBefore_ = "";
-    }
+        Location position;
+        if ( !nextStructural( position ) )
+        {
+            return false;
+        }
+        addTapeEntry( tape, position );
 
+        switch ( *position )
+        {
+        case '{':
+        case '[':
+            if ( nodes_.size() >= stackLimit_ )
+            {
+                return false;
+            }
+            pushNode( 0, *position == '{' ? tokenObjectEnd : tokenArrayEnd );
+            nodes_.back().index_ = Value::ArrayIndex( tape.entries_.size() - 1 );
+            if ( !nextStructural( position ) )
+            {
+                return false;
+            }
+            if ( *position == (nodes_.back().closer_ == tokenObjectEnd ? '}' : ']') )
+            {
+                nodes_.pop_back();
+                break;
+            }
+            if ( nodes_.back().closer_ == tokenObjectEnd )
+            {
+                if ( !readIndexedMember( position, tape ) )
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                --structural_;
+            }
+            continue;
+        case '"':
+            if ( !nextStructural( position )  ||  !endsIndexedValue( position + 1 ) )
+            {
+                return false;
+            }
+            break;
+        case 't':
+            if ( !matchIndexed( position, "true", 4 ) )
+            {
+                return false;
+            }
+            break;
+        case 'f':
+            if ( !matchIndexed( position, "false", 5 ) )
+            {
+                return false;
+            }
+            break;
+        case 'n':
+            if ( !matchIndexed( position, "null", 4 ) )
+            {
+                return false;
+            }
+            break;
+        default:
+            if ( !( isDigit( *position )  ||  *position == '-' )
+                 ||  !endsIndexedValue( skipNumberChars( position, end_ ) ) )
+            {
+                return false;
+            }
+            break;
+        }
 
-    switch ( token.type_ )
-    {
-    case tokenObjectBegin:
-        successful = readObject( token );
-        break;
-    case tokenArrayBegin:
-        successful = readArray( token );
-        break;
-    case tokenNumber:
-        successful = decodeNumber( token );
-        break;
-    case tokenString:
-        successful = decodeString( token );
-        break;
-    case tokenTrue:
-        currentValue() = true;
-        break;
-    case tokenFalse:
-        currentValue() = false;
-        break;
-    case tokenNull:
-        currentValue() = Value();
-        break;
-    default:
-        return addError( "Syntax error: value, object or array expected.", token );
+        while ( !nodes_.empty() )
+        {
+            if ( !nextStructural( position ) )
+            {
+                return false;
+            }
+            Node &node = nodes_.back();
+            if ( *position == (node.closer_ == tokenObjectEnd ? '}' : ']') )
+            {
+                tape.entries_[node.index_].next_ = (unsigned int)tape.entries_.size();
+                nodes_.pop_back();
+                continue;
+            }
+            if ( *position != ',' )
+            {
+                return false;
+            }
+            if ( node.closer_ == tokenObjectEnd )
+            {
+                if ( !nextStructural( position )  ||  !readIndexedMember( position, tape ) )
+                {
+                    return false;
+                }
+            }
+            break;
+        }
+        if ( nodes_.empty() )
+        {
+            return !strict_  ||  !nextStructural( position );
+        }
     }
+}
 
-    if ( collectComments_ )
+
+// A member name is an opening quote, its closing quote and a colon, with
+// nothing but spaces between the last two.
+bool 
+Reader::readIndexedMember( Location position, Tape &tape )
+{
+    if ( *position != '"' )
     {
-        lastValueEnd_ = current_;
-        lastValue_ = &currentValue();
+        return false;
     }
+    addTapeEntry( tape, position );
+    Location close;
+    return nextStructural( close )  &&  nextStructural( position )  &&  *position == ':'
+           &&  ( position == close + 1  ||  isJsonSpace( close[1] ) );
+}
 
-    return successful;
+
+void 
+Reader::addTapeEntry( Tape &tape, Location location )
+{
+    Tape::Entry entry;
+    entry.offset_ = (unsigned int)( location - begin_ );
+    entry.next_ = (unsigned int)tape.entries_.size() + 1;
+    tape.entries_.push_back( entry );
+}
+
+
+bool 
+Reader::addHandlerError( Token &token )
+{
+    return addError( errorStoppedByHandler, token );
 }
 
 
@@ -165,12 +1243,12 @@ Reader::skipCommentTokens( Token &token )
 
 
 bool 
-Reader::expectToken( TokenType type, Token &token, const char *message )
+Reader::expectToken( TokenType type, Token &token, ErrorCode code )
 {
     readToken( token );
     if (token.type_ != type)
     {
-         return addError(message, token);
+         return addError(code, token);
     }
 
     return true;
@@ -204,7 +1282,7 @@ Reader::readToken( Token &token )
         break;
     case '/':
         token.type_ = tokenComment;
-        ok = readComment();
+        ok = !strict_  &&  readComment();
         break;
     case '0':
     case '1':
@@ -259,18 +1337,7 @@ Reader::readToken( Token &token )
 void 
 Reader::skipSpaces()
 {
-    while ( current_ != end_ )
-    {
-        Char c = *current_;
-        if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
-        {
-             ++current_;
-        }
-        else
-        {
-             break;
-        }
-    }
+    current_ = skipSpaceChars( current_, end_ );
 }
 
 
@@ -299,7 +1366,9 @@ Reader::match( Location pattern,
 bool
 Reader::readComment()
 {
+# ifndef JSON_NO_COMMENTS
     Location commentBegin = current_ - 1;
+# endif
     Char c = getNextChar();
     bool successful = false;
     if (c == '*')
@@ -315,6 +1384,7 @@ Reader::readComment()
          return false;
     }
 
+# ifndef JSON_NO_COMMENTS
     if ( collectComments_ )
     {
         CommentPlacement placement = commentBefore;
@@ -328,6 +1398,7 @@ Reader::readComment()
 
         addComment( commentBegin, current_, placement );
     }
+# endif
     return true;
 }
 
@@ -387,158 +1458,233 @@ Reader::readCppStyleComment()
 void 
 Reader::readNumber()
 {
-    while ( current_ != end_ )
-    {
-         if (!(*current_ >= '0'  &&  *current_ <= '9') &&
-              !in(*current_, '.', 'e', 'E', '+', '-'))
-         {
-              break;
-         }
-        ++current_;
-    }
+    current_ = skipNumberChars( current_, end_ );
 }
 
 bool
 Reader::readString()
 {
-    Char c = 0;
-    while ( current_ != end_ )
+    while ( true )
     {
-        c = getNextChar();
-        if (c == '\\')
-        {
-             getNextChar();
-        }
-        else if (c == '"')
+        current_ = findQuoteOrBackslash( current_, end_ );
+        Char c = getNextChar();
+        if (c != '\\')
         {
-             break;
+             return c == '"';
         }
+        getNextChar();
     }
-    return c == '"';
 }
 
 
-bool 
-Reader::readObject( Token &tokenStart )
+Reader::Step 
+Reader::beginObject( Token &token )
+{
+    if ( nodes_.size() > stackLimit_ )
+    {
+        addStackLimitError( token );
+        return stepError;
+    }
+    Value object( objectValue, allocator_ );
+    currentValue().swap( object );
+    nodes_.back().closer_ = tokenObjectEnd;
+    return readObjectMember();
+}
+
+
+// Reads the next member name of the object on top of nodes_ and pushes
+// a node for its value.
+Reader::Step 
+Reader::readObjectMember()
 {
     Token tokenName;
-    std::string name;
-    currentValue() = Value( objectValue );
-    while ( readToken( tokenName ) )
+    skipCommentTokens( tokenName );
+    if (tokenName.type_ == tokenObjectEnd  &&  nodes_.back().emptyName_) 
     {
-        bool initialTokenOk = true;
-        while (tokenName.type_ == tokenComment  &&  initialTokenOk)
-        {
-             initialTokenOk = readToken(tokenName);
-        }
-        if (!initialTokenOk)
-        {
-             break;
-        }
-        if (tokenName.type_ == tokenObjectEnd  &&  name.empty()) 
-        {
-             return true;
-        }
-        if (tokenName.type_ != tokenString)
-        {
-             break;
-        }
-        
-        name = "";
-        if (!decodeString(tokenName, name))
-        {
-             return recoverFromError(tokenObjectEnd);
-        }
+         return stepEndValue;
+    }
+    if (tokenName.type_ != tokenString)
+    {
+        addErrorAndRecover( errorMissingMemberName, 
+                            tokenName, 
+                            tokenObjectEnd );
+        return stepError;
+    }
 
-        Token colon;
-        if ( !readToken( colon ) ||  colon.type_ != tokenMemberSeparator )
+    // Interned names are decoded into decodedString_ first, which needs
+    // no allocation once its buffer has grown.
+    const char *memberName;
+    if ( insitu_  ||  (allocator_  &&  !memberNames_) )
+    {
+        size_t length;
+        bool ok = insitu_ ? decodeStringInPlace(tokenName, memberName, length)
+                          : decodeStringInAllocator(tokenName, memberName, length);
+        if (!ok)
         {
-            return addErrorAndRecover( "Missing ':' after object member name", 
-                                                colon, 
-                                                tokenObjectEnd );
+             recoverFromError(tokenObjectEnd);
+             return stepError;
         }
-        Value &value = currentValue()[ name ];
-        nodes_.push( &value );
-        bool ok = readValue();
-        nodes_.pop();
-      
-        if (!ok) // error already set
+    }
+    else
+    {
+        if (!decodeString(tokenName, decodedString_))
         {
-             return recoverFromError(tokenObjectEnd);
+             recoverFromError(tokenObjectEnd);
+             return stepError;
         }
+        memberName = decodedString_.c_str();
+    }
+    if ( memberNames_ )
+    {
+        memberName = memberNames_->intern( memberName );
+    }
+    nodes_.back().emptyName_ = memberName[0] == 0;
 
-        Token comma;
-        if ( !readToken( comma )
-                ||  ( comma.type_ != tokenObjectEnd  &&  
-                        comma.type_ != tokenArraySeparator &&
-          comma.type_ != tokenComment ) )
-        {
-            return addErrorAndRecover( "Missing ',' or '}' in object declaration", 
-                                                comma, 
-                                                tokenObjectEnd );
-        }
-        bool finalizeTokenOk = true;
-        while (comma.type_ == tokenComment && finalizeTokenOk)
-        {
-             finalizeTokenOk = readToken(comma);
-        }
-        if (comma.type_ == tokenObjectEnd)
-        {
-             return true;
-        }
+    Token colon;
+    if ( !readToken( colon ) ||  colon.type_ != tokenMemberSeparator )
+    {
+        addErrorAndRecover( errorMissingColon, 
+                            colon, 
+                            tokenObjectEnd );
+        return stepError;
+    }
+    // As in readArrayElement(), lastValue_ follows the previous member.
+    Value &object = currentValue();
+    Value::ObjectValues &members = *object.value_.map_;
+    bool previousIsLast = !members.empty()  &&  lastValue_ == &members.end()[-1].second;
+    bool staticName = insitu_  ||  allocator_  ||  memberNames_;
+    Value &value = object.appendMember( staticName ? memberName : decodedString_.c_str(), staticName );
+    if ( previousIsLast )
+    {
+        lastValue_ = &members.end()[-2].second;
     }
+    pushNode( &value, tokenEndOfStream );
+    return stepReadValue;
+}
 
-    return addErrorAndRecover( "Missing '}' or object member name", 
-                                        tokenName, 
-                                        tokenObjectEnd );
+
+Reader::Step 
+Reader::readObjectSeparator()
+{
+    Token comma;
+    if ( !readToken( comma )
+            ||  ( comma.type_ != tokenObjectEnd  &&  
+                    comma.type_ != tokenArraySeparator &&
+      comma.type_ != tokenComment ) )
+    {
+        addErrorAndRecover( errorMissingObjectEnd, 
+                            comma, 
+                            tokenObjectEnd );
+        return stepError;
+    }
+    bool finalizeTokenOk = true;
+    while (comma.type_ == tokenComment && finalizeTokenOk)
+    {
+         finalizeTokenOk = readToken(comma);
+    }
+    if (comma.type_ == tokenObjectEnd)
+    {
+         return stepEndValue;
+    }
+    return readObjectMember();
 }
 
 
-bool 
-Reader::readArray( Token &tokenStart )
+Reader::Step 
+Reader::beginArray( Token &token )
 {
-    currentValue() = Value( arrayValue );
+    if ( nodes_.size() > stackLimit_ )
+    {
+        addStackLimitError( token );
+        return stepError;
+    }
+    Value array( arrayValue, allocator_ );
+    currentValue().swap( array );
+    nodes_.back().closer_ = tokenArrayEnd;
     skipSpaces();
-    if ( *current_ == ']' )
+    if ( current_ != end_  &&  *current_ == ']' )
     {
         Token endArray;
         readToken( endArray );
-        return true;
+        return stepEndValue;
     }
-    int index = 0;
-    while ( true )
+    return readArrayElement();
+}
+
+
+Reader::Step 
+Reader::readArrayElement()
+{
+    // Growing the array may move its elements: lastValue_, which takes
+    // the comment on the previous element's line, follows that element.
+    Value &array = currentValue();
+    Value::ArrayIndex index = nodes_.back().index_++;
+    bool previousIsLast = index > 0  &&  lastValue_ == &array[index - 1];
+    Value &value = array[index];
+    if ( previousIsLast )
     {
-        Value &value = currentValue()[ index++ ];
-        nodes_.push( &value );
-        bool ok = readValue();
-        nodes_.pop();
-        
-        if (!ok)
-        {
-             return recoverFromError(tokenArrayEnd);
-        }
+        lastValue_ = &array[index - 1];
+    }
+    pushNode( &value, tokenEndOfStream );
+    return stepReadValue;
+}
+
+
+Reader::Step 
+Reader::readArraySeparator()
+{
+    Token token;
+    if ( !readToken( token ) 
+          ||  ( token.type_ != tokenArraySeparator  &&  
+                  token.type_ != tokenArrayEnd ) )
+    {
+        addErrorAndRecover( errorMissingArrayEnd, 
+                            token, 
+                            tokenArrayEnd );
+        return stepError;
+    }
+    if (token.type_ == tokenArrayEnd)
+    {
+         return stepEndValue;
+    }
+    return readArrayElement();
+}
+
+
+void 
+Reader::pushNode( Value *value, TokenType closer )
+{
+    Node node;
+    node.value_ = value;
+    node.closer_ = closer;
+    node.index_ = 0;
+    node.emptyName_ = true;
+    nodes_.push_back( node );
+}
 
-        Token token;
-        if ( !readToken( token ) 
-              ||  ( token.type_ != tokenArraySeparator  &&  
-                      token.type_ != tokenArrayEnd ) )
-        {
-            return addErrorAndRecover( "Missing ',' or ']' in array declaration", 
-                                                token, 
-                                                tokenArrayEnd );
-        }
 
-        if (token.type_ == tokenArrayEnd)
-        {
-             break;
-        }
+bool 
+Reader::addStackLimitError( Token &token )
+{
+    return addError( errorStackLimit, token );
+}
+
+
+bool 
+Reader::decodeNumber( Token &token )
+{
+    Value decoded;
+    if (!decodeNumber(token, decoded))
+    {
+         return false;
     }
+    currentValue() = decoded;
     return true;
 }
 
 
 bool 
-Reader::decodeNumber( Token &token )
+Reader::decodeNumber( Token &token, Value &decoded )
 {
     bool isDouble = false;
     for ( Location inspect = token.start_; inspect != token.end_; ++inspect )
@@ -550,7 +1696,7 @@ Reader::decodeNumber( Token &token )
     
     if (isDouble)
     {
-         return decodeDouble(token);
+         return decodeDouble(token, decoded);
     }
 
     Location current = token.start_;
@@ -559,65 +1705,66 @@ Reader::decodeNumber( Token &token )
     {
          ++current;
     }
+    if ( current == token.end_ )
+    {
+         return addError(errorInvalidNumber, token);
+    }
 
-    Value::UInt threshold = (isNegative ? Value::UInt(-Value::minInt) 
-                                                    : Value::maxUInt) / 10;
-    Value::UInt value = 0;
+    Value::LargestUInt maxIntegerValue = isNegative ? Value::LargestUInt(Value::maxLargestInt) + 1
+                                                    : Value::maxLargestUInt;
+    Value::LargestUInt threshold = maxIntegerValue / 10;
+    Value::UInt lastDigitThreshold = Value::UInt( maxIntegerValue % 10 );
+    Value::LargestUInt value = 0;
     while ( current < token.end_ )
     {
         Char c = *current++;
         if (c < '0' || c > '9')
         {
-             return addError("'" + std::string(token.start_, token.end_) + "' is not a number.", token);
+             return addError(errorInvalidNumber, token);
         }
+        Value::UInt digit( c - '0' );
         if (value >= threshold)
         {
-             return decodeDouble(token);
+             // Only a last digit that still fits keeps the value integral.
+             if ( value > threshold  ||  current != token.end_  ||  digit > lastDigitThreshold )
+             {
+                  return decodeDouble(token, decoded);
+             }
         }
-        value = value * 10 + Value::UInt(c - '0');
+        value = value * 10 + digit;
     }
     if (isNegative)
     {
-         currentValue() = -Value::Int(value);
+         // Written so that minLargestInt does not overflow.
+         decoded = value ? -Value::LargestInt(value - 1) - 1 : Value::LargestInt(0);
     }
-    else if (value <= Value::UInt(Value::maxInt))
+    else if (value <= Value::LargestUInt(Value::maxInt))
     {
-         currentValue() = Value::Int(value);
+         decoded = Value::LargestInt(value);
     }
     else
     {
-         currentValue() = value;
+         decoded = value;
     }
     return true;
 }
 
 
 bool 
-Reader::decodeDouble( Token &token )
+Reader::decodeDouble( Token &token, Value &decoded )
 {
-    double value = 0;
-    const int bufferSize = 32;
-    int count;
-    int length = int(token.end_ - token.start_);
-    if ( length <= bufferSize )
-    {
-        Char buffer[bufferSize];
-        memcpy( buffer, token.start_, length );
-        buffer[length] = 0;
-        count = sscanf( buffer, "%lf", &value );
-    }
-    else
+    DecimalNumber number;
+    if ( !splitDecimal( token.start_, token.end_, number ) )
     {
-        std::string buffer( token.start_, token.end_ );
-        count = sscanf( buffer.c_str(), "%lf", &value );
+         return addError(errorInvalidNumber, token);
     }
 
-    if (count != 1)
+    double value;
+    if ( !decimalToDouble( number, value ) )
     {
-         return addError("'" + std::string(token.start_, token.end_) + "' is not a number.", token);
+         value = stringToDouble( token.start_, token.end_ );
     }
-
-    currentValue() = value;
+    decoded = value;
     return true;
 }
 
@@ -625,6 +1772,28 @@ Reader::decodeDouble( Token &token )
 bool 
 Reader::decodeString( Token &token )
 {
+    if ( insitu_  ||  allocator_ )
+    {
+        const Char *decoded;
+        size_t length;
+        bool ok = insitu_ ? decodeStringInPlace(token, decoded, length)
+                          : decodeStringInAllocator(token, decoded, length);
+        if (!ok)
+        {
+             return false;
+        }
+        // A static string ends at its first zero, so one decoded from
+        // \u0000 is copied to the heap, which keeps the length.
+        if ( memchr( decoded, 0, length ) )
+        {
+             currentValue() = std::string( decoded, length );
+             return true;
+        }
+        Value value( (StaticString( decoded )) );
+        currentValue().swap( value );
+        return true;
+    }
+
     std::string decoded;
     if (!decodeString(token, decoded))
     {
@@ -638,7 +1807,59 @@ Reader::decodeString( Token &token )
 bool 
 Reader::decodeString( Token &token, std::string &decoded )
 {
-    decoded.reserve( token.end_ - token.start_ - 2 );
+    decoded.resize( token.end_ - token.start_ - 2 );
+    if ( decoded.empty() )
+    {
+        return true;
+    }
+    Char *outputEnd;
+    if (!unescapeString(token, &decoded[0], outputEnd))
+    {
+         return false;
+    }
+    decoded.resize( outputEnd - &decoded[0] );
+    return true;
+}
+
+
+bool 
+Reader::decodeStringInPlace( Token &token, const Char *&decoded, size_t &length )
+{
+    Char *output = const_cast<Char *>( token.start_ ) + 1;
+    Char *outputEnd;
+    if (!unescapeString(token, output, outputEnd))
+    {
+         return false;
+    }
+    *outputEnd = 0;
+    decoded = output;
+    length = outputEnd - output;
+    return true;
+}
+
+
+bool 
+Reader::decodeStringInAllocator( Token &token, const Char *&decoded, size_t &length )
+{
+    // The quotes leave room for the terminating zero.
+    Char *output = static_cast<Char *>( allocator_->allocate( token.end_ - token.start_ - 1 ) );
+    Char *outputEnd;
+    if (!unescapeString(token, output, outputEnd))
+    {
+         return false;
+    }
+    *outputEnd = 0;
+    decoded = output;
+    length = outputEnd - output;
+    return true;
+}
+
+
+// output may alias the token: an escape sequence never decodes to more
+// bytes than it occupies, so writing never overtakes reading.
+bool 
+Reader::unescapeString( Token &token, Char *output, Char *&outputEnd )
+{
     Location current = token.start_ + 1;
     Location end = token.end_ - 1;
     while ( current != end )
@@ -652,36 +1873,69 @@ Reader::decodeString( Token &token, std::string &decoded )
         {
              if (current == end)
              {
-                  return addError("Empty escape sequence in string", token, current);
+                  return addError(errorEmptyEscape, token, current);
              }
             Char escape = *current++;
             switch ( escape )
             {
-            case '"': decoded += '"'; break;
-            case '/': decoded += '/'; break;
-            case '\\': decoded += '\\'; break;
-            case 'b': decoded += '\b'; break;
-            case 'f': decoded += '\f'; break;
-            case 'n': decoded += '\n'; break;
-            case 'r': decoded += '\r'; break;
-            case 't': decoded += '\t'; break;
+            case '"': *output++ = '"'; break;
+            case '/': *output++ = '/'; break;
+            case '\\': *output++ = '\\'; break;
+            case 'b': *output++ = '\b'; break;
+            case 'f': *output++ = '\f'; break;
+            case 'n': *output++ = '\n'; break;
+            case 'r': *output++ = '\r'; break;
+            case 't': *output++ = '\t'; break;
             case 'u':
                 {
                     unsigned int unicode;
-                    if (!decodeUnicodeEscapeSequence(token, current, end, unicode))
+                    if (!decodeUnicodeCodePoint(token, current, end, unicode))
                     {
                         return false;
                     }
+                    output = codePointToUTF8( unicode, output );
                 }
                 break;
             default:
-                return addError( "Bad escape sequence in string", token, current );
+                return addError( errorBadEscape, token, current );
             }
         }
         else
         {
-            decoded += c;
+            *output++ = c;
+        }
+    }
+    outputEnd = output;
+    return true;
+}
+
+
+bool 
+Reader::decodeUnicodeCodePoint( Token &token, 
+                                         Location &current, 
+                                         Location end, 
+                                         unsigned int &unicode )
+{
+    if (!decodeUnicodeEscapeSequence(token, current, end, unicode))
+    {
+         return false;
+    }
+    if (unicode >= 0xD800 && unicode <= 0xDBFF)
+    {
+        if (end - current < 6)
+        {
+             return addError(errorSurrogateTooShort, token, current);
+        }
+        unsigned int surrogatePair;
+        if (*(current++) != '\\' || *(current++) != 'u')
+        {
+             return addError(errorSurrogateExpected, token, current);
+        }
+        if (!decodeUnicodeEscapeSequence(token, current, end, surrogatePair))
+        {
+             return false;
         }
+        unicode = 0x10000 + ((unicode & 0x3FF) << 10) + (surrogatePair & 0x3FF);
     }
     return true;
 }
@@ -695,7 +1949,7 @@ Reader::decodeUnicodeEscapeSequence( Token &token,
 {
      if (end - current < 4)
      {
-          return addError("Bad unicode escape sequence in string: four digits expected.", token, current);
+          return addError(errorUnicodeTooShort, token, current);
      }
 
     unicode = 0;
@@ -717,7 +1971,7 @@ Reader::decodeUnicodeEscapeSequence( Token &token,
         }
         else
         {
-             return addError("Bad unicode escape sequence in string: hexadecimal digit expected.", token, current);
+             return addError(errorUnicodeDigit, token, current);
         }
     }
     return true;
@@ -725,13 +1979,22 @@ Reader::decodeUnicodeEscapeSequence( Token &token,
 
 
 bool 
-Reader::addError( const std::string &message, 
+Reader::expectEndOfStream()
+{
+    Token token;
+    readToken( token );
+    return token.type_ == tokenEndOfStream  ||  addError( errorExtraData, token );
+}
+
+
+bool 
+Reader::addError( ErrorCode code, 
                         Token &token,
                         Location extra )
 {
     ErrorInfo info;
     info.token_ = token;
-    info.message_ = message;
+    info.code_ = code;
     info.extra_ = extra;
     errors_.push_back( info );
     return false;
@@ -741,6 +2004,10 @@ Reader::addError( const std::string &message,
 bool 
 Reader::recoverFromError( TokenType skipUntilToken )
 {
+    if ( strict_ )
+    {
+        return false;
+    }
     int errorCount = int(errors_.size());
     Token skip;
     while ( true )
@@ -760,11 +2027,11 @@ Reader::recoverFromError( TokenType skipUntilToken )
 
 
 bool 
-Reader::addErrorAndRecover( const std::string &message, 
+Reader::addErrorAndRecover( ErrorCode code, 
                                      Token &token,
                                      TokenType skipUntilToken )
 {
-    addError( message, token );
+    addError( code, token );
     return recoverFromError( skipUntilToken );
 }
 
@@ -772,7 +2039,7 @@ Reader::addErrorAndRecover( const std::string &message,
 Value &
 Reader::currentValue()
 {
-    return *(nodes_.top());
+    return *nodes_.back().value_;
 }
 
 
@@ -830,6 +2097,20 @@ Reader::getLocationLineAndColumn( Location location ) const
 }
 
 
+Reader::ErrorCode 
+Reader::getErrorCode() const
+{
+    return errors_.empty() ? errorNone : errors_.front().code_;
+}
+
+
+size_t 
+Reader::getErrorOffset() const
+{
+    return errors_.empty() ? 0 : size_t(errors_.front().token_.start_ - begin_);
+}
+
+
 std::string 
 Reader::getFormatedErrorMessages() const
 {
@@ -840,7 +2121,16 @@ Reader::getFormatedErrorMessages() const
     {
         const ErrorInfo &error = *itError;
         formattedMessage += "* " + getLocationLineAndColumn( error.token_.start_ ) + "\n";
-        formattedMessage += "  " + error.message_ + "\n";
+        formattedMessage += "  ";
+        if ( error.code_ == errorInvalidNumber )
+        {
+            formattedMessage += "'" + std::string( error.token_.start_, error.token_.end_ ) + "' is not a number.";
+        }
+        else
+        {
+            formattedMessage += errorMessage( error.code_ );
+        }
+        formattedMessage += "\n";
         if (error.extra_)
         {
              formattedMessage += "See " + getLocationLineAndColumn(error.extra_) + " for detail.\n";
@@ -851,6 +2141,325 @@ Reader::getFormatedErrorMessages() const
 }
 
 
+IncrementalReader::IncrementalReader( bool collectComments )
+    : scanned_( 0 )
+    , valueStart_( 0 )
+    , depth_( 0 )
+    , state_( stateIdle )
+    , commentReturnState_( stateIdle )
+    , collectComments_( collectComments )
+    , leadingComments_( false )
+    , holding_( false )
+    , trailingComments_( false )
+    , heldStart_( 0 )
+{
+}
+
+
+bool 
+IncrementalReader::feed( const char *data, size_t length )
+{
+    if ( !errors_.empty() )
+    {
+        return false;
+    }
+    buffer_.append( data, length );
+    if ( !scan() )
+    {
+        return false;
+    }
+
+    size_t consumed = holding_ ? heldStart_
+                               : state_ == stateIdle  &&  !leadingComments_ ? scanned_ : valueStart_;
+    buffer_.erase( 0, consumed );
+    scanned_ -= consumed;
+    valueStart_ -= consumed;
+    if ( holding_ )
+    {
+        heldStart_ -= consumed;
+    }
+    return true;
+}
+
+
+bool 
+IncrementalReader::finish()
+{
+    if ( !errors_.empty() )
+    {
+        return false;
+    }
+    if ( state_ == stateScalar )
+    {
+        state_ = stateIdle;
+        return emitValue( scanned_ );
+    }
+    if ( state_ == stateValueEnd  ||  (state_ == stateLineComment  &&  commentReturnState_ == stateValueEnd) )
+    {
+        return releaseValue( scanned_ );
+    }
+    if ( state_ != stateIdle  &&  state_ != stateLineComment )
+    {
+        errors_ = "* Unexpected end of stream inside a value.\n";
+        return false;
+    }
+    return true;
+}
+
+
+bool 
+IncrementalReader::getNextValue( Value &root )
+{
+    if ( values_.size() <= (holding_ ? 1u : 0u) )
+    {
+        return false;
+    }
+    root.swapWithComments( values_.front() );
+    values_.pop_front();
+    return true;
+}
+
+
+std::string 
+IncrementalReader::getFormatedErrorMessages() const
+{
+    return errors_;
+}
+
+
+// Tracks just enough of the grammar (nesting, strings and comments) to tell
+// where a top-level value ends; the value itself is then parsed by reader_.
+bool 
+IncrementalReader::scan()
+{
+    while ( scanned_ < buffer_.size() )
+    {
+        char c = buffer_[scanned_];
+        switch ( state_ )
+        {
+        case stateIdle:
+            if ( c == ' '  ||  c == '\t'  ||  c == '\r'  ||  c == '\n' )
+            {
+                break;
+            }
+            if ( !leadingComments_ )
+            {
+                valueStart_ = scanned_;
+            }
+            if ( c == '{'  ||  c == '[' )
+            {
+                depth_ = 1;
+                state_ = stateContainer;
+            }
+            else if ( c == '"' )
+            {
+                depth_ = 0;
+                state_ = stateString;
+            }
+            else if ( c == '/' )
+            {
+                // The value's range starts with its leading comments.
+                leadingComments_ = true;
+                commentReturnState_ = stateIdle;
+                state_ = stateCommentStart;
+            }
+            else
+            {
+                state_ = stateScalar;
+            }
+            break;
+        case stateScalar:
+            if ( c == ' '  ||  c == '\t'  ||  c == '\r'  ||  c == '\n'  ||  strchr( "{}[]\"/,:", c ) )
+            {
+                if ( !endValue( scanned_ ) )
+                {
+                    return false;
+                }
+                continue;
+            }
+            break;
+        case stateContainer:
+            if ( c == '"' )
+            {
+                state_ = stateString;
+            }
+            else if ( c == '{'  ||  c == '[' )
+            {
+                ++depth_;
+            }
+            else if ( c == '/' )
+            {
+                commentReturnState_ = stateContainer;
+                state_ = stateCommentStart;
+            }
+            else if ( (c == '}'  ||  c == ']')  &&  --depth_ == 0 )
+            {
+                if ( !endValue( scanned_ + 1 ) )
+                {
+                    return false;
+                }
+            }
+            break;
+        case stateString:
+            if ( c == '\\' )
+            {
+                state_ = stateStringEscape;
+            }
+            else if ( c == '"' )
+            {
+                if ( depth_ > 0 )
+                {
+                    state_ = stateContainer;
+                }
+                else if ( !endValue( scanned_ + 1 ) )
+                {
+                    return false;
+                }
+            }
+            break;
+        case stateStringEscape:
+            state_ = stateString;
+            break;
+        case stateCommentStart:
+            if ( c == '/' )
+            {
+                state_ = stateLineComment;
+            }
+            else if ( c == '*' )
+            {
+                state_ = stateBlockComment;
+            }
+            else
+            {
+                // Not a comment: let reader_ report the stray '/'.
+                state_ = commentReturnState_ == stateIdle ? stateScalar 
+                                                          : commentReturnState_;
+                continue;
+            }
+            break;
+        case stateLineComment:
+            if ( c == '\r'  ||  c == '\n' )
+            {
+                state_ = commentReturnState_;
+                if ( state_ == stateValueEnd )
+                {
+                    continue;
+                }
+            }
+            break;
+        case stateBlockComment:
+            if ( c == '*' )
+            {
+                state_ = stateBlockCommentEnd;
+            }
+            break;
+        case stateBlockCommentEnd:
+            if ( c == '/' )
+            {
+                state_ = commentReturnState_;
+            }
+            else if ( c != '*' )
+            {
+                state_ = stateBlockComment;
+            }
+            break;
+        case stateValueEnd:
+            if ( c == ' '  ||  c == '\t' )
+            {
+                break;
+            }
+            if ( c == '/' )
+            {
+                if ( scanned_ + 1 == buffer_.size() )
+                {
+                    // Wait for the next chunk to tell a comment.
+                    return true;
+                }
+                if ( buffer_[scanned_ + 1] == '/'  ||  buffer_[scanned_ + 1] == '*' )
+                {
+                    trailingComments_ = true;
+                    commentReturnState_ = stateValueEnd;
+                    state_ = stateCommentStart;
+                    break;
+                }
+            }
+            // The line ends, as a comment does, with its first '\r' or '\n'.
+            if ( c == '\r'  ||  c == '\n' )
+            {
+                if ( !releaseValue( scanned_ + 1 ) )
+                {
+                    return false;
+                }
+                break;
+            }
+            if ( !releaseValue( scanned_ ) )
+            {
+                return false;
+            }
+            continue;
+        }
+        ++scanned_;
+    }
+    return true;
+}
+
+
+// A value is parsed as soon as it closes. With comments collected, it is
+// then held back from getNextValue() until the end of its line, where
+// stateValueEnd looks for comments to parse it again with.
+bool 
+IncrementalReader::endValue( size_t end )
+{
+    size_t start = valueStart_;
+    state_ = stateIdle;
+    if ( !emitValue( end ) )
+    {
+        return false;
+    }
+    if ( collectComments_ )
+    {
+        state_ = stateValueEnd;
+        holding_ = true;
+        trailingComments_ = false;
+        heldStart_ = start;
+    }
+    return true;
+}
+
+
+bool 
+IncrementalReader::releaseValue( size_t end )
+{
+    state_ = stateIdle;
+    holding_ = false;
+    if ( !trailingComments_ )
+    {
+        valueStart_ = end;
+        return true;
+    }
+    values_.pop_back();
+    valueStart_ = heldStart_;
+    return emitValue( end );
+}
+
+
+bool 
+IncrementalReader::emitValue( size_t end )
+{
+    const char *begin = buffer_.data();
+    values_.push_back( Value() );
+    if ( !reader_.parse( begin + valueStart_, begin + end, values_.back(), collectComments_ ) )
+    {
+        values_.pop_back();
+        errors_ = reader_.getFormatedErrorMessages();
+        return false;
+    }
+    valueStart_ = end;
+    leadingComments_ = false;
+    return true;
+}
+
+
 std::istream& operator>>( std::istream &sin, Value &root )
 {
      Json::Reader reader;
@@ -0,0 +1,337 @@
+#ifndef JSONCPP_SCANNER_H_INCLUDED
+# define JSONCPP_SCANNER_H_INCLUDED
+
+# if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define JSON_SCANNER_USE_SSE2 1
+#  include <emmintrin.h>
+#  include <cstring>
+#  if defined(_MSC_VER)
+#   include <intrin.h>
+#  endif
+# endif
+
+// Helpers used by Reader and the writers to skip over runs of bytes 16 at a time.
+// Every function returns the first position in [current, end) that does
+// not belong to the run, or end. SSE2 is part of every x86-64 target, so
+// no runtime dispatch is needed; other targets use the scalar loops.
+
+namespace Json {
+
+static inline bool isJsonSpace( char c )
+{
+    return c == ' '  ||  c == '\t'  ||  c == '\r'  ||  c == '\n';
+}
+
+static inline bool isNumberChar( char c )
+{
+    return (c >= '0'  &&  c <= '9')
+             ||  c == '.'  ||  c == 'e'  ||  c == 'E'  ||  c == '+'  ||  c == '-';
+}
+
+static inline bool needsEscape( char c )
+{
+    return (unsigned char)c < 0x20  ||  c == '"'  ||  c == '\\';
+}
+
+# ifdef JSON_SCANNER_USE_SSE2
+
+static inline unsigned int firstSetBit( unsigned int mask )
+{
+#  if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward( &index, mask );
+    return index;
+#  else
+    return __builtin_ctz( mask );
+#  endif
+}
+
+static inline unsigned int spaceMask( __m128i chunk )
+{
+    __m128i spaces = _mm_or_si128( _mm_cmpeq_epi8( chunk, _mm_set1_epi8( ' ' ) ),
+                                   _mm_cmpeq_epi8( chunk, _mm_set1_epi8( '\n' ) ) );
+    spaces = _mm_or_si128( spaces, _mm_cmpeq_epi8( chunk, _mm_set1_epi8( '\t' ) ) );
+    spaces = _mm_or_si128( spaces, _mm_cmpeq_epi8( chunk, _mm_set1_epi8( '\r' ) ) );
+    return unsigned( _mm_movemask_epi8( spaces ) );
+}
+
+static inline unsigned int numberMask( __m128i chunk )
+{
+    __m128i digits = _mm_sub_epi8( chunk, _mm_set1_epi8( '0' ) );
+    __m128i chars = _mm_cmpeq_epi8( _mm_min_epu8( digits, _mm_set1_epi8( 9 ) ), digits );
+    chars = _mm_or_si128( chars, _mm_cmpeq_epi8( chunk, _mm_set1_epi8( '.' ) ) );
+    chars = _mm_or_si128( chars, _mm_cmpeq_epi8( chunk, _mm_set1_epi8( 'e' ) ) );
+    chars = _mm_or_si128( chars, _mm_cmpeq_epi8( chunk, _mm_set1_epi8( 'E' ) ) );
+    chars = _mm_or_si128( chars, _mm_cmpeq_epi8( chunk, _mm_set1_epi8( '+' ) ) );
+    chars = _mm_or_si128( chars, _mm_cmpeq_epi8( chunk, _mm_set1_epi8( '-' ) ) );
+    return unsigned( _mm_movemask_epi8( chars ) );
+}
+
+# endif
+
+static inline const char *skipSpaceChars( const char *current, const char *end )
+{
+    // Most runs are a single separator space, not worth a vector load.
+    if ( current == end  ||  !isJsonSpace( *current ) )
+    {
+        return current;
+    }
+# ifdef JSON_SCANNER_USE_SSE2
+    for ( ; end - current >= 16; current += 16 )
+    {
+        __m128i chunk = _mm_loadu_si128( reinterpret_cast<const __m128i *>( current ) );
+        unsigned int others = ~spaceMask( chunk ) & 0xffff;
+        if ( others )
+        {
+            return current + firstSetBit( others );
+        }
+    }
+# endif
+    while ( current != end  &&  isJsonSpace( *current ) )
+    {
+        ++current;
+    }
+    return current;
+}
+
+static inline const char *findQuoteOrBackslash( const char *current, const char *end )
+{
+# ifdef JSON_SCANNER_USE_SSE2
+    const __m128i quote = _mm_set1_epi8( '"' );
+    const __m128i backslash = _mm_set1_epi8( '\\' );
+    for ( ; end - current >= 16; current += 16 )
+    {
+        __m128i chunk = _mm_loadu_si128( reinterpret_cast<const __m128i *>( current ) );
+        unsigned int found = unsigned( _mm_movemask_epi8(
+            _mm_or_si128( _mm_cmpeq_epi8( chunk, quote ), _mm_cmpeq_epi8( chunk, backslash ) ) ) );
+        if ( found )
+        {
+            return current + firstSetBit( found );
+        }
+    }
+# endif
+    while ( current != end  &&  *current != '"'  &&  *current != '\\' )
+    {
+        ++current;
+    }
+    return current;
+}
+
+// First quote, backslash or control character, i.e. the next byte a JSON
+// string literal cannot hold as is.
+static inline const char *findEscapeChar( const char *current, const char *end )
+{
+# ifdef JSON_SCANNER_USE_SSE2
+    const __m128i quote = _mm_set1_epi8( '"' );
+    const __m128i backslash = _mm_set1_epi8( '\\' );
+    const __m128i lastControl = _mm_set1_epi8( 0x1F );
+    for ( ; end - current >= 16; current += 16 )
+    {
+        __m128i chunk = _mm_loadu_si128( reinterpret_cast<const __m128i *>( current ) );
+        __m128i special = _mm_or_si128( _mm_cmpeq_epi8( chunk, quote ), _mm_cmpeq_epi8( chunk, backslash ) );
+        special = _mm_or_si128( special, _mm_cmpeq_epi8( _mm_min_epu8( chunk, lastControl ), chunk ) );
+        unsigned int found = unsigned( _mm_movemask_epi8( special ) );
+        if ( found )
+        {
+            return current + firstSetBit( found );
+        }
+    }
+# endif
+    while ( current != end  &&  !needsEscape( *current ) )
+    {
+        ++current;
+    }
+    return current;
+}
+
+static inline const char *skipNumberChars( const char *current, const char *end )
+{
+# ifdef JSON_SCANNER_USE_SSE2
+    for ( ; end - current >= 16; current += 16 )
+    {
+        __m128i chunk = _mm_loadu_si128( reinterpret_cast<const __m128i *>( current ) );
+        unsigned int others = ~numberMask( chunk ) & 0xffff;
+        if ( others )
+        {
+            return current + firstSetBit( others );
+        }
+    }
+# endif
+    while ( current != end  &&  isNumberChar( *current ) )
+    {
+        ++current;
+    }
+    return current;
+}
+
+# ifdef JSON_SCANNER_USE_SSE2
+
+// Structural indexing, the first stage of Reader on large tapes: for
+// every 64-byte block, bit masks of quotes, backslashes, spaces and
+// operators are combined without branching into the positions of the
+// bytes the second stage has to look at. Blocks are chained through carries,
+// a combination of the flags below, which start as structuralSeparated.
+enum
+{
+    structuralInString = 1,     // the block ended inside a string
+    structuralEscaped = 2,      // it ended in an odd run of backslashes
+    structuralSeparated = 4     // its last byte was a space or an operator
+};
+
+// One bit per byte of a 64-byte block for each class of byte stage one
+// looks at.
+struct BlockMasks
+{
+    unsigned long long backslashes;
+    unsigned long long quotes;
+    unsigned long long slashes;
+    unsigned long long spaces;
+    unsigned long long operators;
+};
+
+static inline void classifyBlock( const char *block, BlockMasks &masks )
+{
+    masks.backslashes = masks.quotes = masks.slashes = masks.spaces = masks.operators = 0;
+    for ( int index = 0; index < 4; ++index )
+    {
+        __m128i chunk = _mm_loadu_si128( reinterpret_cast<const __m128i *>( block ) + index );
+        // '[' and ']' are '{' and '}' with bit 5 cleared.
+        __m128i folded = _mm_or_si128( chunk, _mm_set1_epi8( 0x20 ) );
+        __m128i operators = _mm_or_si128( _mm_cmpeq_epi8( folded, _mm_set1_epi8( '{' ) ),
+                                          _mm_cmpeq_epi8( folded, _mm_set1_epi8( '}' ) ) );
+        operators = _mm_or_si128( operators, _mm_cmpeq_epi8( chunk, _mm_set1_epi8( ':' ) ) );
+        operators = _mm_or_si128( operators, _mm_cmpeq_epi8( chunk, _mm_set1_epi8( ',' ) ) );
+        int shift = 16 * index;
+        masks.backslashes |= (unsigned long long)unsigned( _mm_movemask_epi8( _mm_cmpeq_epi8( chunk, _mm_set1_epi8( '\\' ) ) ) ) << shift;
+        masks.quotes |= (unsigned long long)unsigned( _mm_movemask_epi8( _mm_cmpeq_epi8( chunk, _mm_set1_epi8( '"' ) ) ) ) << shift;
+        masks.slashes |= (unsigned long long)unsigned( _mm_movemask_epi8( _mm_cmpeq_epi8( chunk, _mm_set1_epi8( '/' ) ) ) ) << shift;
+        masks.spaces |= (unsigned long long)spaceMask( chunk ) << shift;
+        masks.operators |= (unsigned long long)unsigned( _mm_movemask_epi8( operators ) ) << shift;
+    }
+}
+
+// Bit i is the parity of the bits up to and including i.
+static inline unsigned long long prefixXor( unsigned long long bits )
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// Bytes that follow an odd-length run of backslashes, i.e. the escaped
+// ones. A run that starts at an even position and ends at an odd one has
+// odd length, and the other way round; adding each run's start bit to the
+// run carries it to the byte after the run.
+static inline unsigned long long escapedBytes( unsigned long long backslashes, unsigned int &carries )
+{
+    const unsigned long long evenBits = 0x5555555555555555ULL;
+    unsigned long long escapedIn = (carries & structuralEscaped) ? 1 : 0;
+    unsigned long long starts = backslashes & ~(backslashes << 1);
+    unsigned long long evenStartMask = evenBits ^ escapedIn;
+    unsigned long long evenStarts = starts & evenStartMask;
+    unsigned long long oddStarts = starts & ~evenStartMask;
+    unsigned long long evenCarries = backslashes + evenStarts;
+    unsigned long long oddCarries = backslashes + oddStarts;
+    bool escapedOut = oddCarries < backslashes;
+    oddCarries |= escapedIn;
+    carries = escapedOut ? (carries | structuralEscaped) : (carries & ~structuralEscaped);
+    unsigned long long evenCarryEnds = evenCarries & ~backslashes;
+    unsigned long long oddCarryEnds = oddCarries & ~backslashes;
+    return (evenCarryEnds & ~evenBits)  |  (oddCarryEnds & evenBits);
+}
+
+static inline unsigned int bitCount( unsigned long long bits )
+{
+    bits = bits - ((bits >> 1) & 0x5555555555555555ULL);
+    bits = (bits & 0x3333333333333333ULL) + ((bits >> 2) & 0x3333333333333333ULL);
+    bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return unsigned( (bits * 0x0101010101010101ULL) >> 56 );
+}
+
+// Index of the lowest set bit, or 63 if there is none.
+static inline unsigned int lowestBit( unsigned long long bits )
+{
+    bits |= 0x8000000000000000ULL;
+#  if defined(_MSC_VER)  &&  defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64( &index, bits );
+    return index;
+#  elif defined(_MSC_VER)
+    unsigned int low = unsigned( bits );
+    return low ? firstSetBit( low ) : 32 + firstSetBit( unsigned( bits >> 32 ) );
+#  else
+    return __builtin_ctzll( bits );
+#  endif
+}
+
+// Writes eight offsets at a time, past the count if need be, which keeps
+// the loop free of branches the set bits would decide; out needs room for
+// seven offsets more than bits holds.
+static inline unsigned int *appendPositions( unsigned int *out, unsigned int offset, unsigned long long bits )
+{
+    unsigned int *end = out + bitCount( bits );
+    while ( bits )
+    {
+        for ( int index = 0; index < 8; ++index )
+        {
+            out[index] = offset + lowestBit( bits );
+            bits &= bits - 1;
+        }
+        out += 8;
+    }
+    return end;
+}
+
+// Writes to out the offsets from base of the operators, unescaped quotes
+// and first bytes of literals and numbers in [begin, end), which is a
+// multiple of 64 bytes long unless it ends the document. out must have
+// room for one offset per byte, and seven more. Returns the end of the
+// offsets written, or 0 if a slash or backslash appears outside strings:
+// comments, and the errors a stray backslash causes, are left to the
+// tokenizer.
+static inline unsigned int *indexStructurals( const char *base, const char *begin, const char *end,
+                                              unsigned int &carries, unsigned int *out )
+{
+    for ( const char *block = begin; block < end; block += 64 )
+    {
+        BlockMasks masks;
+        if ( end - block >= 64 )
+        {
+            classifyBlock( block, masks );
+        }
+        else
+        {
+            char padded[64];
+            memset( padded, ' ', sizeof(padded) );
+            memcpy( padded, block, end - block );
+            classifyBlock( padded, masks );
+        }
+
+        unsigned long long quotes = masks.quotes & ~escapedBytes( masks.backslashes, carries );
+        unsigned long long inString = prefixXor( quotes ) ^ ((carries & structuralInString) ? ~0ULL : 0);
+        if ( ( masks.slashes | masks.backslashes ) & ~inString )
+        {
+            return 0;
+        }
+        carries = (inString >> 63) ? (carries | structuralInString) : (carries & ~structuralInString);
+
+        unsigned long long separators = masks.spaces | masks.operators;
+        unsigned long long follows = (separators << 1)  |  ((carries & structuralSeparated) ? 1 : 0);
+        carries = (separators >> 63) ? (carries | structuralSeparated) : (carries & ~structuralSeparated);
+        unsigned long long scalars = follows & ~separators & ~quotes;
+
+        unsigned long long structurals = ((masks.operators | scalars) & ~inString)  |  quotes;
+        out = appendPositions( out, unsigned( block - base ), structurals );
+    }
+    return out;
+}
+
+# endif
+
+} // namespace Json
+
+#endif // JSONCPP_SCANNER_H_INCLUDED
@@ -0,0 +1,271 @@
+#include "tape.h"
+#include "reader.h"
+#include "json_scanner.h"
+#include <cstring>
+
+namespace Json {
+
+Tape::Tape()
+    : begin_( 0 )
+    , end_( 0 )
+{
+}
+
+
+TapeView
+Tape::root() const
+{
+    return entries_.empty() ? TapeView() : TapeView( this, 0 );
+}
+
+
+size_t
+Tape::size() const
+{
+    return entries_.size();
+}
+
+
+TapeView::TapeView()
+    : tape_( 0 )
+    , index_( 0 )
+{
+}
+
+
+TapeView::TapeView( const Tape *tape, unsigned int index )
+    : tape_( tape )
+    , index_( index )
+{
+}
+
+
+const char *
+TapeView::location() const
+{
+    return tape_->begin_ + tape_->entries_[index_].offset_;
+}
+
+
+bool
+TapeView::isValid() const
+{
+    return tape_ != 0;
+}
+
+
+ValueType
+TapeView::type() const
+{
+    if ( !tape_ )
+    {
+        return nullValue;
+    }
+    switch ( *location() )
+    {
+    case '{':
+        return objectValue;
+    case '[':
+        return arrayValue;
+    case '"':
+        return stringValue;
+    case 't':
+    case 'f':
+        return booleanValue;
+    case 'n':
+        return nullValue;
+    default:
+        return asValue().type();
+    }
+}
+
+
+Value::ArrayIndex
+TapeView::size() const
+{
+    ValueType kind = type();
+    if ( kind != arrayValue  &&  kind != objectValue )
+    {
+        return 0;
+    }
+    const Tape::Entries &entries = tape_->entries_;
+    unsigned int end = entries[index_].next_;
+    Value::ArrayIndex count = 0;
+    for ( unsigned int index = index_ + 1; index < end; index = entries[index].next_ )
+    {
+        if ( kind == objectValue )
+        {
+            ++index;
+        }
+        ++count;
+    }
+    return count;
+}
+
+
+bool
+TapeView::isMember( const char *key ) const
+{
+    return findMember( key, strlen( key ) ).isValid();
+}
+
+
+TapeView
+TapeView::operator[]( Value::ArrayIndex index ) const
+{
+    if ( type() != arrayValue )
+    {
+        return TapeView();
+    }
+    const Tape::Entries &entries = tape_->entries_;
+    unsigned int end = entries[index_].next_;
+    unsigned int element = index_ + 1;
+    for ( ; element < end  &&  index > 0; --index )
+    {
+        element = entries[element].next_;
+    }
+    return element < end ? TapeView( tape_, element ) : TapeView();
+}
+
+
+TapeView
+TapeView::operator[]( const char *key ) const
+{
+    return findMember( key, strlen( key ) );
+}
+
+
+TapeView
+TapeView::operator[]( const std::string &key ) const
+{
+    return findMember( key.data(), key.length() );
+}
+
+
+TapeView
+TapeView::findMember( const char *key, size_t length ) const
+{
+    if ( type() != objectValue )
+    {
+        return TapeView();
+    }
+    const Tape::Entries &entries = tape_->entries_;
+    unsigned int end = entries[index_].next_;
+    for ( unsigned int name = index_ + 1; name < end; name = entries[name + 1].next_ )
+    {
+        if ( nameEquals( name, key, length ) )
+        {
+            return TapeView( tape_, name + 1 );
+        }
+    }
+    return TapeView();
+}
+
+
+// Compares the raw bytes of the member name when it has no escape
+// sequence, and its decoded text otherwise.
+bool
+TapeView::nameEquals( unsigned int index, const char *key, size_t length ) const
+{
+    const char *name = tape_->begin_ + tape_->entries_[index].offset_ + 1;
+    const char *special = findQuoteOrBackslash( name, tape_->end_ );
+    if ( special == tape_->end_  ||  *special == '\\' )
+    {
+        std::string decoded = TapeView( tape_, index ).asValue().asString();
+        return decoded.length() == length  &&  memcmp( decoded.data(), key, length ) == 0;
+    }
+    return size_t(special - name) == length  &&  memcmp( name, key, length ) == 0;
+}
+
+
+Value
+TapeView::asValue() const
+{
+    Value value;
+    if ( tape_ )
+    {
+        Reader reader;
+        reader.parse( location(), tape_->end_, value, false );
+    }
+    return value;
+}
+
+
+std::string
+TapeView::asString() const
+{
+    if ( type() == stringValue )
+    {
+        const char *begin = location() + 1;
+        const char *special = findQuoteOrBackslash( begin, tape_->end_ );
+        if ( special != tape_->end_  &&  *special == '"' )
+        {
+            return std::string( begin, special );
+        }
+    }
+    return asValue().asString();
+}
+
+
+Value::Int
+TapeView::asInt() const
+{
+    return asValue().asInt();
+}
+
+
+Value::UInt
+TapeView::asUInt() const
+{
+    return asValue().asUInt();
+}
+
+
+# if defined(JSON_HAS_INT64)
+Value::Int64
+TapeView::asInt64() const
+{
+    return asValue().asInt64();
+}
+
+
+Value::UInt64
+TapeView::asUInt64() const
+{
+    return asValue().asUInt64();
+}
+# endif
+
+
+Value::LargestInt
+TapeView::asLargestInt() const
+{
+    return asValue().asLargestInt();
+}
+
+
+Value::LargestUInt
+TapeView::asLargestUInt() const
+{
+    return asValue().asLargestUInt();
+}
+
+
+double
+TapeView::asDouble() const
+{
+    return asValue().asDouble();
+}
+
+
+bool
+TapeView::asBool() const
+{
+    if ( type() == booleanValue )
+    {
+        return *location() == 't';
+    }
+    return asValue().asBool();
+}
+
+} // namespace Json
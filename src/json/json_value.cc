@@ -1,11 +1,21 @@
 #include <iostream>
 #include "value.h"
 #include "writer.h"
+#include "tape.h"
 #include <utility>
 #include <stdexcept>
 #include <cstring>
 #include <cassert>
 #include <cstddef>
+#include <algorithm>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+# if defined(_MSC_VER)
+#  include <intrin.h>
+# endif
 
 # include "json_allocator.h"
 
@@ -19,66 +29,515 @@ const Value Value::null;
 const Value::Int Value::minInt = Value::Int( ~(Value::UInt(-1)/2) );
 const Value::Int Value::maxInt = Value::Int( Value::UInt(-1)/2 );
 const Value::UInt Value::maxUInt = Value::UInt(-1);
+# if defined(JSON_HAS_INT64)
+const Value::Int64 Value::minInt64 = Value::Int64( ~(Value::UInt64(-1)/2) );
+const Value::Int64 Value::maxInt64 = Value::Int64( Value::UInt64(-1)/2 );
+const Value::UInt64 Value::maxUInt64 = Value::UInt64(-1);
+# endif
+const Value::LargestInt Value::minLargestInt = Value::LargestInt( ~(Value::LargestUInt(-1)/2) );
+const Value::LargestInt Value::maxLargestInt = Value::LargestInt( Value::LargestUInt(-1)/2 );
+const Value::LargestUInt Value::maxLargestUInt = Value::LargestUInt(-1);
+
+static_assert( sizeof(Value) == 16, "Value should pack into 16 bytes" );
+
+// Strings and member names of heap values. Inline so the default path
+// costs a plain malloc/free. The length is kept in front of the
+// characters, so copies and the writers need not measure them again.
+static const size_t stringHeaderSize = sizeof(unsigned int);
+
+static inline char *
+duplicateStringValue( const char *value, 
+                      unsigned int length = (unsigned int)-1 )
+{
+    if (length == (unsigned int)-1)
+    {
+        length = (unsigned int)strlen(value);
+    }
+    char *block = static_cast<char *>( malloc( stringHeaderSize + length + 1 ) );
+    if ( block == 0 )
+    {
+        throw std::bad_alloc();
+    }
+    memcpy( block, &length, stringHeaderSize );
+    char *newString = block + stringHeaderSize;
+    memcpy( newString, value, length );
+    newString[length] = 0;
+    return newString;
+}
+
+static inline unsigned int 
+duplicatedStringLength( const char *value )
+{
+    unsigned int length;
+    memcpy( &length, value - stringHeaderSize, stringHeaderSize );
+    return length;
+}
+
+static inline void 
+releaseStringValue( char *value )
+{
+    if ( value )
+    {
+        free( value - stringHeaderSize );
+    }
+}
+
 
 ValueAllocator::~ValueAllocator()
 {
 }
 
-class DefaultValueAllocator : public ValueAllocator
+char *
+ValueAllocator::duplicate( const char *value, size_t length )
+{
+    char *copy = static_cast<char *>( allocate( length + 1 ) );
+    memcpy( copy, value, length );
+    copy[length] = 0;
+    return copy;
+}
+
+
+struct ValueArena::Block
+{
+    Block *next_;
+};
+
+// Rounds sizes and the block header up so every allocation is suitably
+// aligned for Value and its payloads.
+static const size_t arenaAlignment = 8;
+
+static size_t alignArenaSize( size_t size )
 {
-public:
-    virtual ~DefaultValueAllocator()
+    return (size + arenaAlignment - 1) & ~(arenaAlignment - 1);
+}
+
+ValueArena::ValueArena( size_t blockSize )
+    : blocks_( 0 )
+    , current_( 0 )
+    , end_( 0 )
+    , blockSize_( alignArenaSize( blockSize ) )
+{
+}
+
+ValueArena::~ValueArena()
+{
+    release();
+}
+
+void *
+ValueArena::allocate( size_t size )
+{
+    size = alignArenaSize( size );
+    if ( size > size_t( end_ - current_ ) )
     {
+        // Large requests get a block of their own so the tail of the
+        // current block stays in use.
+        if ( size > blockSize_ / 4 )
+        {
+            return allocateBlock( size );
+        }
+        current_ = static_cast<char *>( allocateBlock( blockSize_ ) );
+        end_ = current_ + blockSize_;
     }
+    void *storage = current_;
+    current_ += size;
+    return storage;
+}
+
+void 
+ValueArena::release()
+{
+    while ( blocks_ )
+    {
+        Block *next = blocks_->next_;
+        free( blocks_ );
+        blocks_ = next;
+    }
+    current_ = end_ = 0;
+}
+
+void *
+ValueArena::allocateBlock( size_t size )
+{
+    const size_t headerSize = alignArenaSize( sizeof(Block) );
+    Block *block = static_cast<Block *>( malloc( headerSize + size ) );
+    if ( block == 0 )
+    {
+        throw std::bad_alloc();
+    }
+    block->next_ = blocks_;
+    blocks_ = block;
+    return reinterpret_cast<char *>( block ) + headerSize;
+}
+
+
+struct MemberNameTable::Entry
+{
+    Entry *next_;
+    size_t hash_;
+    size_t length_;
+    char name_[1];
+};
+
+// Buckets are published with release stores and entries never change
+// once linked, so lookups only need acquire loads; inserts serialize on
+// mutex_ and carve their entries from names_.
+struct MemberNameTable::Table
+{
+    explicit Table( size_t bucketCount )
+        : buckets_( new std::atomic<Entry *>[bucketCount] )
+        , mask_( bucketCount - 1 )
+        , size_( 0 )
+    {
+        for ( size_t index = 0; index < bucketCount; ++index )
+        {
+            buckets_[index].store( 0, std::memory_order_relaxed );
+        }
+    }
+
+    ~Table()
+    {
+        delete [] buckets_;
+    }
+
+    std::atomic<Entry *> *buckets_;
+    size_t mask_;
+    size_t size_;
+    std::mutex mutex_;
+    ValueArena names_;
+};
 
-    virtual char *makeMemberName( const char *memberName )
+// FNV-1a.
+static size_t hashMemberName( const char *name, size_t length )
+{
+    size_t hash = size_t( 2166136261u );
+    for ( size_t index = 0; index < length; ++index )
     {
-        return duplicateStringValue( memberName );
+        hash = (hash ^ (unsigned char)name[index]) * size_t( 16777619u );
     }
+    return hash;
+}
 
-    virtual void releaseMemberName( char *memberName )
+MemberNameTable::MemberNameTable( size_t bucketCount )
+    : table_( 0 )
+{
+    size_t buckets = 1;
+    while ( buckets < bucketCount )
     {
-        releaseStringValue( memberName );
+        buckets *= 2;
     }
+    table_ = new Table( buckets );
+}
+
+MemberNameTable::~MemberNameTable()
+{
+    delete table_;
+}
 
-    virtual char *duplicateStringValue( const char *value, 
-                                                    unsigned int length = unknown )
+const char *
+MemberNameTable::intern( const char *name )
+{
+    return intern( name, strlen( name ) );
+}
+
+const char *
+MemberNameTable::intern( const char *name, size_t length )
+{
+    size_t hash = hashMemberName( name, length );
+    std::atomic<Entry *> &bucket = table_->buckets_[hash & table_->mask_];
+    Entry *seen = bucket.load( std::memory_order_acquire );
+    for ( Entry *entry = seen; entry; entry = entry->next_ )
     {
+        if ( entry->hash_ == hash  &&  entry->length_ == length  &&  memcmp( entry->name_, name, length ) == 0 )
+        {
+            return entry->name_;
+        }
+    }
 
-        if (length == unknown)
+    std::lock_guard<std::mutex> lock( table_->mutex_ );
+    Entry *head = bucket.load( std::memory_order_relaxed );
+    // Only the entries linked since the lookup above are left to check.
+    for ( Entry *entry = head; entry != seen; entry = entry->next_ )
+    {
+        if ( entry->hash_ == hash  &&  entry->length_ == length  &&  memcmp( entry->name_, name, length ) == 0 )
         {
-            length = (unsigned int)strlen(value);
+            return entry->name_;
         }
-        char *newString = static_cast<char *>( malloc( length + 1 ) );
-        memcpy( newString, value, length );
-        newString[length] = 0;
-        return newString;
     }
+    Entry *entry = static_cast<Entry *>( table_->names_.allocate( offsetof( Entry, name_ ) + length + 1 ) );
+    entry->next_ = head;
+    entry->hash_ = hash;
+    entry->length_ = length;
+    memcpy( entry->name_, name, length );
+    entry->name_[length] = 0;
+    bucket.store( entry, std::memory_order_release );
+    ++table_->size_;
+    return entry->name_;
+}
+
+size_t 
+MemberNameTable::size() const
+{
+    std::lock_guard<std::mutex> lock( table_->mutex_ );
+    return table_->size_;
+}
+
 
-    virtual void releaseStringValue( char *value )
+static void *allocateStorage( ValueAllocator *allocator, size_t size )
+{
+    void *storage = allocator ? allocator->allocate( size ) : malloc( size );
+    if ( storage == 0 )
     {
-         if (value)
-         {
-              free(value);
-         }
+        throw std::bad_alloc();
+    }
+    return storage;
+}
+
+static void releaseStorage( ValueAllocator *allocator, void *storage )
+{
+    if ( !allocator )
+    {
+        free( storage );
+    }
+}
+
+template <typename Container>
+static Container *allocateContainer()
+{
+    return SharedBatchAllocator<Container, 1>::allocate();
+}
+
+// Owner counts of shared containers, see Value::share().
+static inline long loadShareCount( volatile long &count )
+{
+# if defined(_MSC_VER)
+    return _InterlockedCompareExchange( &count, 0, 0 );
+# else
+    return __atomic_load_n( &count, __ATOMIC_ACQUIRE );
+# endif
+}
+
+static inline void incrementShareCount( volatile long &count )
+{
+# if defined(_MSC_VER)
+    _InterlockedIncrement( &count );
+# else
+    __atomic_add_fetch( &count, 1, __ATOMIC_RELAXED );
+# endif
+}
+
+static inline long decrementShareCount( volatile long &count )
+{
+# if defined(_MSC_VER)
+    return _InterlockedDecrement( &count );
+# else
+    return __atomic_sub_fetch( &count, 1, __ATOMIC_ACQ_REL );
+# endif
+}
+
+// Containers carved from an allocator are destroyed in place; their
+// memory goes back with the allocator. Shared ones go with their last
+// owner.
+template <typename Container>
+static void releaseContainer( Container *container )
+{
+    volatile long &count = container->shareCount();
+    if ( loadShareCount( count ) > 0  &&  decrementShareCount( count ) > 0 )
+    {
+        return;
+    }
+    ValueAllocator *allocator = container->allocator();
+    container->~Container();
+    if ( !allocator )
+    {
+        SharedBatchAllocator<Container, 1>::release( container );
+    }
+}
+
+template <typename Container>
+static Container *copyContainer( Container *other )
+{
+    if ( loadShareCount( other->shareCount() ) > 0 )
+    {
+        incrementShareCount( other->shareCount() );
+        return other;
+    }
+    return new ( allocateContainer<Container>() ) Container( *other );
+}
+
+// Makes container safe to modify: a shared one is replaced by a clone of
+// its first level, a sole owner simply stops sharing it.
+template <typename Container>
+static Container *unshareContainer( Container *container )
+{
+    volatile long &count = container->shareCount();
+    long owners = loadShareCount( count );
+    if ( owners == 0 )
+    {
+        return container;
+    }
+    if ( owners == 1 )
+    {
+        count = 0;
+        return container;
+    }
+    Container *copy = new ( allocateContainer<Container>() ) Container( *container );
+    releaseContainer( container );
+    return copy;
+}
+
+
+# ifndef JSON_NO_COMMENTS
+Value::CommentInfo *
+Value::allocateComments()
+{
+    CommentInfo *comments = SharedBatchAllocator<CommentInfo, numberOfCommentPlacement>::allocate();
+    for ( int comment = 0; comment < numberOfCommentPlacement; ++comment )
+    {
+        new ( comments + comment ) CommentInfo();
+    }
+    return comments;
+}
+
+void 
+Value::releaseComments( CommentInfo *comments )
+{
+    for ( int comment = 0; comment < numberOfCommentPlacement; ++comment )
+    {
+        comments[comment].~CommentInfo();
     }
+    SharedBatchAllocator<CommentInfo, numberOfCommentPlacement>::release( comments );
+}
+
+struct Value::CommentTable
+{
+    typedef std::unordered_map<const Value *, CommentInfo *> Map;
+
+    CommentInfo *take( const Value *value, bool hasComments )
+    {
+        if ( !hasComments )
+        {
+            return 0;
+        }
+        Map::iterator it = comments_.find( value );
+        JSON_ASSERT( it != comments_.end() );
+        CommentInfo *comments = it->second;
+        comments_.erase( it );
+        return comments;
+    }
+
+    void put( const Value *value, CommentInfo *comments )
+    {
+        if ( comments )
+        {
+            comments_[value] = comments;
+        }
+    }
+
+    std::mutex mutex_;
+    Map comments_;
 };
 
-static ValueAllocator *&valueAllocator()
+// Values with comments are rare, so a single locked map serves all
+// threads. It is never destroyed, like the node pools, so values
+// outliving static destruction can still drop their comments.
+// Reading a comment takes the same mutex: getComment() and hasComment()
+// on commented values are serialized across threads, even on const
+// trees (C++11 has no shared mutex). Values without comments never
+// lock.
+Value::CommentTable &
+Value::commentTable()
 {
-    static DefaultValueAllocator defaultAllocator;
-    static ValueAllocator *valueAllocator = &defaultAllocator;
-    return valueAllocator;
+    static CommentTable *table = new CommentTable;
+    return *table;
 }
 
-static struct DummyValueAllocatorInitializer {
-    DummyValueAllocatorInitializer() 
+Value::CommentInfo *
+Value::comments() const
+{
+    if ( !hasComments_ )
     {
-        valueAllocator(); 
+        return 0;
+    }
+    CommentTable &table = commentTable();
+    std::lock_guard<std::mutex> lock( table.mutex_ );
+    CommentTable::Map::const_iterator it = table.comments_.find( this );
+    JSON_ASSERT( it != table.comments_.end() );
+    return it->second;
+}
+
+Value::CommentInfo *
+Value::makeComments()
+{
+    if ( hasComments_ )
+    {
+        return comments();
+    }
+    CommentInfo *comments = allocateComments();
+    CommentTable &table = commentTable();
+    {
+        std::lock_guard<std::mutex> lock( table.mutex_ );
+        table.comments_[this] = comments;
     }
-} dummyValueAllocatorInitializer;
+    hasComments_ = true;
+    return comments;
+}
+
+void 
+Value::dropComments()
+{
+    if ( !hasComments_ )
+    {
+        return;
+    }
+    CommentTable &table = commentTable();
+    CommentInfo *comments;
+    {
+        std::lock_guard<std::mutex> lock( table.mutex_ );
+        comments = table.take( this, true );
+    }
+    releaseComments( comments );
+    hasComments_ = false;
+}
+
+// Moves the comments of other, if any, to this value, which has none.
+void 
+Value::takeComments( Value &other )
+{
+    if ( !other.hasComments_ )
+    {
+        return;
+    }
+    CommentTable &table = commentTable();
+    std::lock_guard<std::mutex> lock( table.mutex_ );
+    table.put( this, table.take( &other, true ) );
+    hasComments_ = true;
+    other.hasComments_ = false;
+}
+# else
+void 
+Value::dropComments()
+{
+}
+
+void 
+Value::takeComments( Value & )
+{
+}
+# endif
+
+void 
+Value::releaseThreadCache()
+{
+    SharedBatchAllocator<ArrayValues, 1>::releaseThreadCache();
+    SharedBatchAllocator<ObjectValues, 1>::releaseThreadCache();
+# ifndef JSON_NO_COMMENTS
+    SharedBatchAllocator<CommentInfo, numberOfCommentPlacement>::releaseThreadCache();
+# endif
+}
 
 
+# ifndef JSON_NO_COMMENTS
 Value::CommentInfo::CommentInfo()
     : comment_( 0 )
 {
@@ -88,7 +547,7 @@ Value::CommentInfo::~CommentInfo()
 {
     if (comment_)
     {
-        valueAllocator()->releaseStringValue(comment_);
+        releaseStringValue(comment_);
     }
         
 }
@@ -99,14 +558,15 @@ Value::CommentInfo::setComment( const char *text )
 {
     if (comment_)
     {
-        valueAllocator()->releaseStringValue(comment_);
+        releaseStringValue(comment_);
     }
 
     JSON_ASSERT( text );
     JSON_ASSERT_MESSAGE( text[0]=='\0' || text[0]=='/', "Comments must start with /");
     
-    comment_ = valueAllocator()->duplicateStringValue( text );
+    comment_ = duplicateStringValue( text );
 }
+# endif
 
 Value::CZString::CZString( int index )
     : cstr_( 0 )
@@ -115,31 +575,94 @@ Value::CZString::CZString( int index )
 }
 
 Value::CZString::CZString( const char *cstr, DuplicationPolicy allocate )
-    : cstr_( allocate == duplicate ? valueAllocator()->makeMemberName(cstr) : cstr )
+    : cstr_( cstr )
     , index_( allocate )
 {
+    if ( allocate == duplicate )
+    {
+        setName( cstr, strlen( cstr ) );
+    }
 }
 
+// Copies own their name unless it is static.
 Value::CZString::CZString( const CZString &other )
-: cstr_( other.index_ != noDuplication &&  other.cstr_ != 0
-                     ?  valueAllocator()->makeMemberName( other.cstr_ )
-                     : other.cstr_ )
-    , index_( other.cstr_ ? (other.index_ == noDuplication ? noDuplication : duplicate) : other.index_ )
+    : cstr_( other.cstr_ )
+    , index_( other.index_ )
 {
+    if ( other.index_ == inlineName )
+    {
+        memcpy( inlineChars(), other.c_str(), inlineNameSize );
+    }
+    else if ( other.cstr_  &&  other.index_ != noDuplication )
+    {
+        setName( other.cstr_, other.length() );
+    }
+}
+
+# if defined(JSON_HAS_RVALUE_REFERENCES)
+// Borrowed duplicateOnCopy names still get their copy here, as the
+// source never owned them.
+Value::CZString::CZString( CZString &&other )
+    : cstr_( other.cstr_ )
+    , index_( other.index_ )
+{
+    if ( other.index_ == inlineName )
+    {
+        memcpy( inlineChars(), other.c_str(), inlineNameSize );
+    }
+    else if ( cstr_  &&  index_ == duplicateOnCopy )
+    {
+        setName( cstr_, strlen( cstr_ ) );
+    }
+    else
+    {
+        other.cstr_ = 0;
+        other.index_ = 0;
+    }
 }
+# endif
 
 Value::CZString::~CZString()
 {
     if (cstr_  &&  index_ == duplicate)
     {
-        valueAllocator()->releaseMemberName(const_cast<char *>(cstr_));
+        releaseStringValue(const_cast<char *>(cstr_));
     }
 }
 
+// Stores an owned copy of name, in place when it is short enough.
+void 
+Value::CZString::setName( const char *name, size_t length )
+{
+    if ( length < inlineNameSize )
+    {
+        char *chars = inlineChars();
+        memcpy( chars, name, length );
+        chars[length] = 0;
+        index_ = inlineName;
+    }
+    else
+    {
+        cstr_ = duplicateStringValue( name, (unsigned int)length );
+        index_ = duplicate;
+    }
+}
+
+// cstr_ is the first member, followed directly by inlineNameTail_.
+char *
+Value::CZString::inlineChars()
+{
+    return reinterpret_cast<char *>( this );
+}
+
 void 
 Value::CZString::swap( CZString &other )
 {
     std::swap( cstr_, other.cstr_ );
+    for ( int index = 0; index < int(sizeof(inlineNameTail_)); ++index )
+    {
+        std::swap( inlineNameTail_[index], other.inlineNameTail_[index] );
+    }
     std::swap( index_, other.index_ );
 }
 
@@ -151,12 +674,24 @@ Value::CZString::operator =( const CZString &other )
     return *this;
 }
 
+# if defined(JSON_HAS_RVALUE_REFERENCES)
+Value::CZString &
+Value::CZString::operator =( CZString &&other )
+{
+    CZString temp( std::move( other ) );
+    swap( temp );
+    return *this;
+}
+# endif
+
 bool 
 Value::CZString::operator<( const CZString &other ) const 
 {
-    if (cstr_)
+    const char *name = c_str();
+    if (name)
     {
-        return strcmp(cstr_, other.cstr_) < 0;
+        const char *otherName = other.c_str();
+        return name != otherName  &&  strcmp(name, otherName) < 0;
     }
 
     return index_ < other.index_;
@@ -165,9 +700,11 @@ Value::CZString::operator<( const CZString &other ) const
 bool 
 Value::CZString::operator==( const CZString &other ) const 
 {
-    if (cstr_)
+    const char *name = c_str();
+    if (name)
     {
-        return strcmp(cstr_, other.cstr_) == 0;
+        const char *otherName = other.c_str();
+        return name == otherName  ||  strcmp(name, otherName) == 0;
     }
 
     return index_ == other.index_;
@@ -184,7 +721,17 @@ Value::CZString::index() const
 const char *
 Value::CZString::c_str() const
 {
-    return cstr_;
+    return index_ == inlineName ? reinterpret_cast<const char *>( this ) : cstr_;
+}
+
+size_t 
+Value::CZString::length() const
+{
+    if ( index_ == duplicate )
+    {
+        return duplicatedStringLength( cstr_ );
+    }
+    return strlen( c_str() );
 }
 
 bool 
@@ -194,10 +741,473 @@ Value::CZString::isStaticString() const
 }
 
 
+Value::ObjectValues::ObjectValues( ValueAllocator *allocator )
+    : members_( reinterpret_cast<value_type *>( inline_.buffer_ ) )
+    , size_( 0 )
+    , capacity_( inlineCapacity )
+    , allocator_( allocator )
+    , shareCount_( 0 )
+{
+}
+
+// The copy lives on the heap. Member names of an object built in an
+// allocator may point into it, so they are always duplicated.
+Value::ObjectValues::ObjectValues( const ObjectValues &other )
+    : members_( reinterpret_cast<value_type *>( inline_.buffer_ ) )
+    , size_( 0 )
+    , capacity_( inlineCapacity )
+    , allocator_( 0 )
+    , shareCount_( 0 )
+{
+    reserve( other.size_ );
+    for ( ; size_ < other.size_; ++size_ )
+    {
+        const value_type &member = other.members_[size_];
+        if ( other.allocator_ )
+        {
+            new ( members_ + size_ ) value_type( CZString( member.first.c_str(), CZString::duplicate ), 
+                                                 member.second );
+        }
+        else
+        {
+            new ( members_ + size_ ) value_type( member );
+        }
+    }
+}
+
+Value::ObjectValues::~ObjectValues()
+{
+    clear();
+    if ( !isInline() )
+    {
+        releaseStorage( allocator_, members_ );
+    }
+}
+
+ValueAllocator *
+Value::ObjectValues::allocator() const
+{
+    return allocator_;
+}
+
+volatile long &
+Value::ObjectValues::shareCount()
+{
+    return shareCount_;
+}
+
+Value::ArrayIndex 
+Value::ObjectValues::size() const
+{
+    return size_;
+}
+
+bool 
+Value::ObjectValues::empty() const
+{
+    return size_ == 0;
+}
+
+Value::ObjectValues::iterator 
+Value::ObjectValues::find( const CZString &key )
+{
+    iterator it = lower_bound( key );
+    if ( it != end()  &&  it->first == key )
+    {
+        return it;
+    }
+    return end();
+}
+
+Value::ObjectValues::const_iterator 
+Value::ObjectValues::find( const CZString &key ) const
+{
+    return const_cast<ObjectValues *>( this )->find( key );
+}
+
+Value::ObjectValues::iterator 
+Value::ObjectValues::lower_bound( const CZString &key )
+{
+    iterator first = members_;
+    ArrayIndex count = size_;
+    while ( count > 0 )
+    {
+        ArrayIndex step = count / 2;
+        iterator middle = first + step;
+        if ( middle->first < key )
+        {
+            first = middle + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+    return first;
+}
+
+Value::ObjectValues::const_iterator 
+Value::ObjectValues::lower_bound( const CZString &key ) const
+{
+    return const_cast<ObjectValues *>( this )->lower_bound( key );
+}
+
+// Members hold no pointer into themselves, so the ones after position
+// are shifted with a single memmove. Comments are keyed by the address of
+// their value, so if any of those members has some, the new member is
+// instead constructed at the end and swapped down into place.
+Value::ObjectValues::iterator 
+Value::ObjectValues::insert( iterator position, const CZString &key )
+{
+    ArrayIndex index = ArrayIndex( position - members_ );
+    JSON_ASSERT( index <= size_ );
+    if ( size_ == capacity_ )
+    {
+        reserve( capacity_ * 2 );
+    }
+    if ( canRelocate( index, size_ ) )
+    {
+        memmove( static_cast<void *>( members_ + index + 1 ), members_ + index, 
+                 (size_ - index) * sizeof(value_type) );
+        new ( members_ + index ) value_type( key, Value() );
+    }
+    else
+    {
+        new ( members_ + size_ ) value_type( key, Value() );
+        for ( ArrayIndex current = size_; current > index; --current )
+        {
+            swapMembers( members_[current], members_[current - 1] );
+        }
+    }
+    ++size_;
+    return members_ + index;
+}
+
+// Adds a member at the end, leaving the order to sort().
+Value::ObjectValues::iterator 
+Value::ObjectValues::append( const CZString &key )
+{
+    if ( size_ == capacity_ )
+    {
+        reserve( capacity_ * 2 );
+    }
+    new ( members_ + size_ ) value_type( key, Value() );
+    return members_ + size_++;
+}
+
+// Sorts members added by append() and keeps the last of equal names, as
+// assigning them in turn would. Members are only swapped, so comments
+// follow them. Returns whether any member moved.
+bool 
+Value::ObjectValues::sort()
+{
+    ArrayIndex index = 1;
+    while ( index < size_  &&  members_[index - 1].first < members_[index].first )
+    {
+        ++index;
+    }
+    if ( index >= size_ )
+    {
+        return false;
+    }
+
+    struct ByName
+    {
+        const value_type *members_;
+        bool operator()( ArrayIndex a, ArrayIndex b ) const
+        {
+            return members_[a].first < members_[b].first;
+        }
+    };
+    std::vector<ArrayIndex> order( size_ );
+    for ( index = 0; index < size_; ++index )
+    {
+        order[index] = index;
+    }
+    ByName byName = { members_ };
+    std::stable_sort( order.begin(), order.end(), byName );
+
+    // Applies the permutation one cycle at a time: position gets the
+    // member order[position] held.
+    for ( ArrayIndex start = 0; start < size_; ++start )
+    {
+        ArrayIndex position = start;
+        while ( order[position] != start )
+        {
+            ArrayIndex source = order[position];
+            order[position] = position;
+            swapMembers( members_[position], members_[source] );
+            position = source;
+        }
+        order[position] = position;
+    }
+
+    ArrayIndex kept = 0;
+    for ( index = 0; index < size_; ++index )
+    {
+        if ( index + 1 < size_  &&  members_[index].first == members_[index + 1].first )
+        {
+            continue;
+        }
+        if ( kept != index )
+        {
+            swapMembers( members_[kept], members_[index] );
+        }
+        ++kept;
+    }
+    while ( size_ > kept )
+    {
+        members_[--size_].~value_type();
+    }
+    return true;
+}
+
+void 
+Value::ObjectValues::erase( iterator position )
+{
+    JSON_ASSERT( position >= members_  &&  position < end() );
+    ArrayIndex index = ArrayIndex( position - members_ );
+    if ( canRelocate( index + 1, size_ ) )
+    {
+        position->~value_type();
+        memmove( static_cast<void *>( position ), position + 1, (size_ - index - 1) * sizeof(value_type) );
+        --size_;
+        return;
+    }
+    for ( iterator next = position + 1; next != end(); ++position, ++next )
+    {
+        swapMembers( *position, *next );
+    }
+    members_[--size_].~value_type();
+}
+
+// Whether members [first, last) may be moved bytewise; see insert().
+bool 
+Value::ObjectValues::canRelocate( ArrayIndex first, ArrayIndex last ) const
+{
+    for ( ArrayIndex index = first; index < last; ++index )
+    {
+        if ( members_[index].second.hasComments_ )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void 
+Value::ObjectValues::clear()
+{
+    while ( size_ > 0 )
+    {
+        members_[--size_].~value_type();
+    }
+}
+
+Value::ObjectValues::iterator 
+Value::ObjectValues::begin()
+{
+    return members_;
+}
+
+Value::ObjectValues::iterator 
+Value::ObjectValues::end()
+{
+    return members_ + size_;
+}
+
+Value::ObjectValues::const_iterator 
+Value::ObjectValues::begin() const
+{
+    return members_;
+}
+
+Value::ObjectValues::const_iterator 
+Value::ObjectValues::end() const
+{
+    return members_ + size_;
+}
+
+void 
+Value::ObjectValues::reserve( ArrayIndex newCapacity )
+{
+    if ( newCapacity <= capacity_ )
+    {
+        return;
+    }
+    value_type *members = static_cast<value_type *>( allocateStorage( allocator_, sizeof(value_type) * newCapacity ) );
+    for ( ArrayIndex index = 0; index < size_; ++index )
+    {
+        new ( members + index ) value_type( CZString( 0 ), Value() );
+        swapMembers( members[index], members_[index] );
+        members_[index].~value_type();
+    }
+    if ( !isInline() )
+    {
+        releaseStorage( allocator_, members_ );
+    }
+    members_ = members;
+    capacity_ = newCapacity;
+}
+
+bool 
+Value::ObjectValues::isInline() const
+{
+    return members_ == reinterpret_cast<const value_type *>( inline_.buffer_ );
+}
+
+void 
+Value::ObjectValues::swapMembers( value_type &a, value_type &b )
+{
+    a.first.swap( b.first );
+    a.second.swapWithComments( b.second );
+}
+
+
+Value::ArrayValues::ArrayValues( ValueAllocator *allocator )
+    : values_( 0 )
+    , size_( 0 )
+    , capacity_( 0 )
+    , allocator_( allocator )
+    , shareCount_( 0 )
+{
+}
+
+Value::ArrayValues::ArrayValues( const ArrayValues &other )
+    : values_( 0 )
+    , size_( 0 )
+    , capacity_( 0 )
+    , allocator_( 0 )
+    , shareCount_( 0 )
+{
+    reserve( other.size_ );
+    for ( ; size_ < other.size_; ++size_ )
+    {
+        new ( values_ + size_ ) Value( other.values_[size_] );
+    }
+}
+
+Value::ArrayValues::~ArrayValues()
+{
+    clear();
+    releaseStorage( allocator_, values_ );
+}
+
+ValueAllocator *
+Value::ArrayValues::allocator() const
+{
+    return allocator_;
+}
+
+volatile long &
+Value::ArrayValues::shareCount()
+{
+    return shareCount_;
+}
+
+Value::ArrayIndex 
+Value::ArrayValues::size() const
+{
+    return size_;
+}
+
+bool 
+Value::ArrayValues::empty() const
+{
+    return size_ == 0;
+}
+
+Value &
+Value::ArrayValues::operator[]( ArrayIndex index )
+{
+    JSON_ASSERT( index < size_ );
+    return values_[index];
+}
+
+const Value &
+Value::ArrayValues::operator[]( ArrayIndex index ) const
+{
+    JSON_ASSERT( index < size_ );
+    return values_[index];
+}
+
+void 
+Value::ArrayValues::resize( ArrayIndex newSize )
+{
+    if ( newSize > capacity_ )
+    {
+        ArrayIndex newCapacity = capacity_ ? capacity_ * 2 : 4;
+        reserve( newCapacity < newSize ? newSize : newCapacity );
+    }
+    for ( ; size_ < newSize; ++size_ )
+    {
+        new ( values_ + size_ ) Value();
+    }
+    while ( size_ > newSize )
+    {
+        values_[--size_].~Value();
+    }
+}
+
+// Elements are moved to the new buffer by swapping them with null values,
+// so growing the array never deep-copies the nested values.
+void 
+Value::ArrayValues::reserve( ArrayIndex newCapacity )
+{
+    if ( newCapacity <= capacity_ )
+    {
+        return;
+    }
+    Value *values = static_cast<Value *>( allocateStorage( allocator_, sizeof(Value) * newCapacity ) );
+    for ( ArrayIndex index = 0; index < size_; ++index )
+    {
+        new ( values + index ) Value();
+        values[index].swapWithComments( values_[index] );
+        values_[index].~Value();
+    }
+    releaseStorage( allocator_, values_ );
+    values_ = values;
+    capacity_ = newCapacity;
+}
+
+void 
+Value::ArrayValues::clear()
+{
+    resize( 0 );
+}
+
+Value::ArrayValues::iterator 
+Value::ArrayValues::begin()
+{
+    return values_;
+}
+
+Value::ArrayValues::iterator 
+Value::ArrayValues::end()
+{
+    return values_ + size_;
+}
+
+Value::ArrayValues::const_iterator 
+Value::ArrayValues::begin() const
+{
+    return values_;
+}
+
+Value::ArrayValues::const_iterator 
+Value::ArrayValues::end() const
+{
+    return values_ + size_;
+}
+
+
 Value::Value( ValueType type )
     : type_( type )
     , allocated_( 0 )
-    , comments_( 0 )
+    , inlineString_( 0 )
+    , hasComments_( 0 )
+    , inlineLength_( 0 )
 {
     switch ( type )
     {
@@ -214,8 +1224,10 @@ Value::Value( ValueType type )
         value_.string_ = 0;
         break;
     case arrayValue:
+        value_.array_ = new ( allocateContainer<ArrayValues>() ) ArrayValues();
+        break;
     case objectValue:
-        value_.map_ = new ObjectValues();
+        value_.map_ = new ( allocateContainer<ObjectValues>() ) ObjectValues();
         break;
     case booleanValue:
         value_.bool_ = false;
@@ -226,9 +1238,34 @@ Value::Value( ValueType type )
 }
 
 
+Value::Value( ValueType type, ValueAllocator *allocator )
+    : type_( type )
+    , allocated_( 0 )
+    , inlineString_( 0 )
+    , hasComments_( 0 )
+    , inlineLength_( 0 )
+{
+    JSON_ASSERT_MESSAGE( type == arrayValue  ||  type == objectValue, 
+                         "Only arrays and objects can be given an allocator" );
+    if ( type == arrayValue )
+    {
+        void *storage = allocator ? allocateStorage( allocator, sizeof(ArrayValues) ) : allocateContainer<ArrayValues>();
+        value_.array_ = new ( storage ) ArrayValues( allocator );
+    }
+    else
+    {
+        void *storage = allocator ? allocateStorage( allocator, sizeof(ObjectValues) ) : allocateContainer<ObjectValues>();
+        value_.map_ = new ( storage ) ObjectValues( allocator );
+    }
+}
+
+
 Value::Value( Int value )
     : type_( intValue )
-    , comments_( 0 )
+    , allocated_( 0 )
+    , inlineString_( 0 )
+    , hasComments_( 0 )
+    , inlineLength_( 0 )
 {
     value_.int_ = value;
 }
@@ -236,47 +1273,83 @@ Value::Value( Int value )
 
 Value::Value( UInt value )
     : type_( uintValue )
-    , comments_( 0 )
+    , allocated_( 0 )
+    , inlineString_( 0 )
+    , hasComments_( 0 )
+    , inlineLength_( 0 )
 {
     value_.uint_ = value;
 }
 
+# if defined(JSON_HAS_INT64)
+Value::Value( Int64 value )
+    : type_( intValue )
+    , allocated_( 0 )
+    , inlineString_( 0 )
+    , hasComments_( 0 )
+    , inlineLength_( 0 )
+{
+    value_.int_ = value;
+}
+
+
+Value::Value( UInt64 value )
+    : type_( uintValue )
+    , allocated_( 0 )
+    , inlineString_( 0 )
+    , hasComments_( 0 )
+    , inlineLength_( 0 )
+{
+    value_.uint_ = value;
+}
+# endif
+
 Value::Value( double value )
     : type_( realValue )
-    , comments_( 0 )
+    , allocated_( 0 )
+    , inlineString_( 0 )
+    , hasComments_( 0 )
+    , inlineLength_( 0 )
 {
     value_.real_ = value;
 }
 
 Value::Value( const char *value )
     : type_( stringValue )
-    , allocated_( true )
-    , comments_( 0 )
+    , allocated_( 0 )
+    , inlineString_( 0 )
+    , hasComments_( 0 )
+    , inlineLength_( 0 )
 {
-    value_.string_ = valueAllocator()->duplicateStringValue( value );
+    setString( value, strlen( value ) );
 }
 
 Value::Value( const std::string &value )
     : type_( stringValue )
-    , allocated_( true )
-    , comments_( 0 )
-
+    , allocated_( 0 )
+    , inlineString_( 0 )
+    , hasComments_( 0 )
+    , inlineLength_( 0 )
 {
-    value_.string_ = valueAllocator()->duplicateStringValue( value.c_str(),  (unsigned int)value.length() );
-
+    setString( value.data(), value.length() );
 }
 
 Value::Value( const StaticString &value )
     : type_( stringValue )
-    , allocated_( false )
-    , comments_( 0 )
+    , allocated_( 0 )
+    , inlineString_( 0 )
+    , hasComments_( 0 )
+    , inlineLength_( 0 )
 {
     value_.string_ = const_cast<char *>( value.c_str() );
 }
 
 Value::Value( bool value )
     : type_( booleanValue )
-    , comments_( 0 )
+    , allocated_( 0 )
+    , inlineString_( 0 )
+    , hasComments_( 0 )
+    , inlineLength_( 0 )
 {
     value_.bool_ = value;
 }
@@ -284,7 +1357,10 @@ Value::Value( bool value )
 
 Value::Value( const Value &other )
     : type_( other.type_ )
-    , comments_( 0 )
+    , allocated_( 0 )
+    , inlineString_( 0 )
+    , hasComments_( 0 )
+    , inlineLength_( 0 )
 {
     switch ( type_ )
     {
@@ -296,10 +1372,15 @@ Value::Value( const Value &other )
         value_ = other.value_;
         break;
     case stringValue:
-        if ( other.value_.string_ )
+        if ( other.inlineString_ )
+        {
+            memcpy( inlineChars(), other.stringData(), inlineStringSize );
+            inlineString_ = true;
+            inlineLength_ = other.inlineLength_;
+        }
+        else if ( other.value_.string_ )
         {
-            value_.string_ = valueAllocator()->duplicateStringValue( other.value_.string_ );
-            allocated_ = true;
+            setString( other.value_.string_, other.stringLength() );
         }
         else
         {
@@ -307,26 +1388,44 @@ Value::Value( const Value &other )
         }
         break;
     case arrayValue:
+        value_.array_ = copyContainer( other.value_.array_ );
+        break;
     case objectValue:
-        value_.map_ = new ObjectValues( *other.value_.map_ );
+        value_.map_ = copyContainer( other.value_.map_ );
         break;
     default:
         JSON_ASSERT_UNREACHABLE;
     }
-    if ( other.comments_ )
+# ifndef JSON_NO_COMMENTS
+    if ( other.hasComments_ )
     {
-        comments_ = new CommentInfo[numberOfCommentPlacement];
+        const CommentInfo *otherComments = other.comments();
+        CommentInfo *comments = makeComments();
         for ( int comment =0; comment < numberOfCommentPlacement; ++comment )
         {
-            const CommentInfo &otherComment = other.comments_[comment];
+            const CommentInfo &otherComment = otherComments[comment];
             if (otherComment.comment_)
             {
-                 comments_[comment].setComment(otherComment.comment_);
+                 comments[comment].setComment(otherComment.comment_);
             }
         }
     }
+# endif
 }
 
+# if defined(JSON_HAS_RVALUE_REFERENCES)
+Value::Value( Value &&other )
+    : type_( nullValue )
+    , allocated_( 0 )
+    , inlineString_( 0 )
+    , hasComments_( 0 )
+    , inlineLength_( 0 )
+{
+    swap( other );
+    takeComments( other );
+}
+# endif
+
 
 Value::~Value()
 {
@@ -341,22 +1440,21 @@ Value::~Value()
     case stringValue:
          if (allocated_)
          {
-              valueAllocator()->releaseStringValue(value_.string_);
+              releaseStringValue(value_.string_);
          }
         break;
 
     case arrayValue:
+        releaseContainer( value_.array_ );
+        break;
     case objectValue:
-        delete value_.map_;
+        releaseContainer( value_.map_ );
         break;
     default:
         JSON_ASSERT_UNREACHABLE;
     }
 
-    if (comments_)
-    {
-         delete[] comments_;
-    }
+    dropComments();
 }
 
 Value &
@@ -367,22 +1465,159 @@ Value::operator=( const Value &other )
     return *this;
 }
 
+# if defined(JSON_HAS_RVALUE_REFERENCES)
+Value &
+Value::operator=( Value &&other )
+{
+    Value temp;
+    temp.swap( other );
+    swap( temp );
+    return *this;
+}
+# endif
+
 void 
 Value::swap( Value &other )
 {
-    ValueType temp = type_;
-    type_ = other.type_;
-    other.type_ = temp;
     std::swap( value_, other.value_ );
-    int temp2 = allocated_;
+    for ( int index = 0; index < int(sizeof(inlineStringTail_)); ++index )
+    {
+        std::swap( inlineStringTail_[index], other.inlineStringTail_[index] );
+    }
+    std::swap( type_, other.type_ );
+    bool temp = allocated_;
     allocated_ = other.allocated_;
-    other.allocated_ = temp2;
+    other.allocated_ = temp;
+    temp = inlineString_;
+    inlineString_ = other.inlineString_;
+    other.inlineString_ = temp;
+    unsigned char length = inlineLength_;
+    inlineLength_ = other.inlineLength_;
+    other.inlineLength_ = length;
+}
+
+void 
+Value::swapWithComments( Value &other )
+{
+    swap( other );
+# ifndef JSON_NO_COMMENTS
+    if ( !hasComments_  &&  !other.hasComments_ )
+    {
+        return;
+    }
+    CommentTable &table = commentTable();
+    std::lock_guard<std::mutex> lock( table.mutex_ );
+    CommentInfo *comments = table.take( this, hasComments_ );
+    CommentInfo *otherComments = table.take( &other, other.hasComments_ );
+    table.put( this, otherComments );
+    table.put( &other, comments );
+    bool temp = hasComments_;
+    hasComments_ = other.hasComments_;
+    other.hasComments_ = temp;
+# endif
+}
+
+// The first member of a Value is value_, followed directly by
+// inlineStringTail_, so an inline string spans both.
+char *
+Value::inlineChars()
+{
+    return reinterpret_cast<char *>( this );
+}
+
+const char *
+Value::stringData() const
+{
+    return inlineString_ ? reinterpret_cast<const char *>( this ) : value_.string_;
+}
+
+size_t 
+Value::stringLength() const
+{
+    if ( inlineString_ )
+    {
+        return inlineLength_;
+    }
+    if ( allocated_ )
+    {
+        return duplicatedStringLength( value_.string_ );
+    }
+    return value_.string_ ? strlen( value_.string_ ) : 0;
+}
+
+// Stores a copy of value in a value whose string storage is unused.
+void 
+Value::setString( const char *value, size_t length )
+{
+    if ( length < inlineStringSize )
+    {
+        char *chars = inlineChars();
+        memcpy( chars, value, length );
+        chars[length] = 0;
+        inlineString_ = true;
+        inlineLength_ = (unsigned char)length;
+    }
+    else
+    {
+        value_.string_ = duplicateStringValue( value, (unsigned int)length );
+        allocated_ = true;
+    }
+}
+
+// A container already shared has no unshared containers below it, as
+// reaching those takes a non-const accessor that unshares it first.
+void 
+Value::share()
+{
+    if ( type_ == arrayValue )
+    {
+        ArrayValues &values = *value_.array_;
+        if ( loadShareCount( values.shareCount() ) == 0 )
+        {
+            for ( ArrayValues::iterator it = values.begin(); it != values.end(); ++it )
+            {
+                it->share();
+            }
+            if ( !values.allocator() )
+            {
+                values.shareCount() = 1;
+            }
+        }
+    }
+    else if ( type_ == objectValue )
+    {
+        ObjectValues &members = *value_.map_;
+        if ( loadShareCount( members.shareCount() ) == 0 )
+        {
+            for ( ObjectValues::iterator it = members.begin(); it != members.end(); ++it )
+            {
+                it->second.share();
+            }
+            if ( !members.allocator() )
+            {
+                members.shareCount() = 1;
+            }
+        }
+    }
+}
+
+void 
+Value::unshare()
+{
+    if ( type_ == arrayValue )
+    {
+        value_.array_ = unshareContainer( value_.array_ );
+    }
+    else if ( type_ == objectValue )
+    {
+        value_.map_ = unshareContainer( value_.map_ );
+    }
 }
 
 ValueType 
 Value::type() const
 {
-    return type_;
+    return ValueType( type_ );
 }
 
 
@@ -413,11 +1648,28 @@ Value::operator <( const Value &other ) const
     case booleanValue:
         return value_.bool_ < other.value_.bool_;
     case stringValue:
-        return ( value_.string_ == 0  &&  other.value_.string_ )
-                 || ( other.value_.string_  
-                        &&  value_.string_  
-                        && strcmp( value_.string_, other.value_.string_ ) < 0 );
+        {
+            const char *string = stringData();
+            const char *otherString = other.stringData();
+            if ( string == 0  ||  otherString == 0 )
+            {
+                return string == 0  &&  otherString;
+            }
+            size_t length = stringLength();
+            size_t otherLength = other.stringLength();
+            int comparison = memcmp( string, otherString, std::min( length, otherLength ) );
+            return comparison < 0  ||  ( comparison == 0  &&  length < otherLength );
+        }
     case arrayValue:
+        {
+            int delta = int( value_.array_->size() - other.value_.array_->size() );
+            if (delta)
+            {
+                 return delta < 0;
+            }
+            return std::lexicographical_compare( value_.array_->begin(), value_.array_->end(),
+                                                 other.value_.array_->begin(), other.value_.array_->end() );
+        }
     case objectValue:
         {
             int delta = int( value_.map_->size() - other.value_.map_->size() );
@@ -425,7 +1677,8 @@ Value::operator <( const Value &other ) const
             {
                  return delta < 0;
             }
-            return (*value_.map_) < (*other.value_.map_);
+            return std::lexicographical_compare( value_.map_->begin(), value_.map_->end(),
+                                                 other.value_.map_->begin(), other.value_.map_->end() );
         }
     default:
         JSON_ASSERT_UNREACHABLE;
@@ -473,14 +1726,27 @@ Value::operator ==( const Value &other ) const
     case booleanValue:
         return value_.bool_ == other.value_.bool_;
     case stringValue:
-        return ( value_.string_ == other.value_.string_ )
-                 || ( other.value_.string_  
-                        &&  value_.string_  
-                        && strcmp( value_.string_, other.value_.string_ ) == 0 );
+        {
+            const char *string = stringData();
+            const char *otherString = other.stringData();
+            if ( string == otherString )
+            {
+                return true;
+            }
+            size_t length = stringLength();
+            return otherString  
+                     &&  string  
+                     &&  length == other.stringLength()
+                     &&  memcmp( string, otherString, length ) == 0;
+        }
     case arrayValue:
+        return value_.array_->size() == other.value_.array_->size()
+                 && std::equal( value_.array_->begin(), value_.array_->end(),
+                                other.value_.array_->begin() );
     case objectValue:
         return value_.map_->size() == other.value_.map_->size()
-                 && (*value_.map_) == (*other.value_.map_);
+                 && std::equal( value_.map_->begin(), value_.map_->end(),
+                                other.value_.map_->begin() );
     default:
         JSON_ASSERT_UNREACHABLE;
     }
@@ -497,7 +1763,20 @@ const char *
 Value::asCString() const
 {
     JSON_ASSERT( type_ == stringValue );
-    return value_.string_;
+    return stringData();
+}
+
+
+bool 
+Value::getString( const char **begin, const char **end ) const
+{
+    if ( type_ != stringValue )
+    {
+        return false;
+    }
+    *begin = stringData() ? stringData() : "";
+    *end = *begin + stringLength();
+    return true;
 }
 
 
@@ -509,7 +1788,7 @@ Value::asString() const
     case nullValue:
         return "";
     case stringValue:
-        return value_.string_ ? value_.string_ : "";
+        return std::string( stringData() ? stringData() : "", stringLength() );
     case booleanValue:
         return value_.bool_ ? "true" : "false";
     case intValue:
@@ -532,10 +1811,11 @@ Value::asInt() const
     case nullValue:
         return 0;
     case intValue:
-        return value_.int_;
+        JSON_ASSERT_MESSAGE( value_.int_ >= minInt  &&  value_.int_ <= maxInt, "integer out of signed integer range" );
+        return Int( value_.int_ );
     case uintValue:
-        JSON_ASSERT_MESSAGE( value_.uint_ < (unsigned)maxInt, "integer out of signed integer range" );
-        return value_.uint_;
+        JSON_ASSERT_MESSAGE( value_.uint_ <= LargestUInt(maxInt), "integer out of signed integer range" );
+        return Int( value_.uint_ );
     case realValue:
         JSON_ASSERT_MESSAGE( value_.real_ >= minInt  &&  value_.real_ <= maxInt, "Real out of signed integer range" );
         return Int( value_.real_ );
@@ -560,9 +1840,11 @@ Value::asUInt() const
         return 0;
     case intValue:
         JSON_ASSERT_MESSAGE( value_.int_ >= 0, "Negative integer can not be converted to unsigned integer" );
-        return value_.int_;
+        JSON_ASSERT_MESSAGE( LargestUInt(value_.int_) <= maxUInt, "integer out of unsigned integer range" );
+        return UInt( value_.int_ );
     case uintValue:
-        return value_.uint_;
+        JSON_ASSERT_MESSAGE( value_.uint_ <= maxUInt, "integer out of unsigned integer range" );
+        return UInt( value_.uint_ );
     case realValue:
         JSON_ASSERT_MESSAGE( value_.real_ >= 0  &&  value_.real_ <= maxUInt,  "Real out of unsigned integer range" );
         return UInt( value_.real_ );
@@ -578,6 +1860,89 @@ Value::asUInt() const
     return 0; // unreachable;
 }
 
+
+# if defined(JSON_HAS_INT64)
+
+Value::Int64 
+Value::asInt64() const
+{
+    switch ( type_ )
+    {
+    case nullValue:
+        return 0;
+    case intValue:
+        return value_.int_;
+    case uintValue:
+        JSON_ASSERT_MESSAGE( value_.uint_ <= UInt64(maxInt64), "integer out of signed Int64 range" );
+        return Int64( value_.uint_ );
+    case realValue:
+        // 2^63 is exact in a double, maxInt64 is not.
+        JSON_ASSERT_MESSAGE( value_.real_ >= -9223372036854775808.0  &&  value_.real_ < 9223372036854775808.0, "Real out of signed Int64 range" );
+        return Int64( value_.real_ );
+    case booleanValue:
+        return value_.bool_ ? 1 : 0;
+    case stringValue:
+    case arrayValue:
+    case objectValue:
+        JSON_ASSERT_MESSAGE( false, "Type is not convertible to Int64" );
+    default:
+        JSON_ASSERT_UNREACHABLE;
+    }
+    return 0; // unreachable;
+}
+
+
+Value::UInt64 
+Value::asUInt64() const
+{
+    switch ( type_ )
+    {
+    case nullValue:
+        return 0;
+    case intValue:
+        JSON_ASSERT_MESSAGE( value_.int_ >= 0, "Negative integer can not be converted to UInt64" );
+        return UInt64( value_.int_ );
+    case uintValue:
+        return value_.uint_;
+    case realValue:
+        JSON_ASSERT_MESSAGE( value_.real_ >= 0  &&  value_.real_ < 18446744073709551616.0, "Real out of UInt64 range" );
+        return UInt64( value_.real_ );
+    case booleanValue:
+        return value_.bool_ ? 1 : 0;
+    case stringValue:
+    case arrayValue:
+    case objectValue:
+        JSON_ASSERT_MESSAGE( false, "Type is not convertible to UInt64" );
+    default:
+        JSON_ASSERT_UNREACHABLE;
+    }
+    return 0; // unreachable;
+}
+
+# endif // if defined(JSON_HAS_INT64)
+
+
+Value::LargestInt 
+Value::asLargestInt() const
+{
+# if defined(JSON_HAS_INT64)
+    return asInt64();
+# else
+    return asInt();
+# endif
+}
+
+
+Value::LargestUInt 
+Value::asLargestUInt() const
+{
+# if defined(JSON_HAS_INT64)
+    return asUInt64();
+# else
+    return asUInt();
+# endif
+}
+
 double 
 Value::asDouble() const
 {
@@ -618,8 +1983,9 @@ Value::asBool() const
     case booleanValue:
         return value_.bool_;
     case stringValue:
-        return value_.string_  &&  value_.string_[0] != 0;
+        return stringData()  &&  stringData()[0] != 0;
     case arrayValue:
+        return !value_.array_->empty();
     case objectValue:
         return value_.map_->size() != 0;
     default:
@@ -638,15 +2004,15 @@ Value::isConvertibleTo( ValueType other ) const
         return true;
     case intValue:
         return ( other == nullValue  &&  value_.int_ == 0 )
-                 || other == intValue
-                 || ( other == uintValue  && value_.int_ >= 0 )
+                 || ( other == intValue  &&  value_.int_ >= minInt  &&  value_.int_ <= maxInt )
+                 || ( other == uintValue  &&  value_.int_ >= 0  &&  LargestUInt(value_.int_) <= maxUInt )
                  || other == realValue
                  || other == stringValue
                  || other == booleanValue;
     case uintValue:
         return ( other == nullValue  &&  value_.uint_ == 0 )
-                 || ( other == intValue  && value_.uint_ <= (unsigned)maxInt )
-                 || other == uintValue
+                 || ( other == intValue  && value_.uint_ <= LargestUInt(maxInt) )
+                 || ( other == uintValue  &&  value_.uint_ <= maxUInt )
                  || other == realValue
                  || other == stringValue
                  || other == booleanValue;
@@ -666,10 +2032,10 @@ Value::isConvertibleTo( ValueType other ) const
                  || other == booleanValue;
     case stringValue:
         return other == stringValue
-                 || ( other == nullValue  &&  (!value_.string_  ||  value_.string_[0] == 0) );
+                 || ( other == nullValue  &&  (!stringData()  ||  stringData()[0] == 0) );
     case arrayValue:
         return other == arrayValue
-                 ||  ( other == nullValue  &&  value_.map_->size() == 0 );
+                 ||  ( other == nullValue  &&  value_.array_->empty() );
     case objectValue:
         return other == objectValue
                  ||  ( other == nullValue  &&  value_.map_->size() == 0 );
@@ -693,13 +2059,7 @@ Value::size() const
     case stringValue:
         return 0;
     case arrayValue:
-        if ( !value_.map_->empty() )
-        {
-            ObjectValues::const_iterator itLast = value_.map_->end();
-            --itLast;
-            return (*itLast).first.index()+1;
-        }
-        return 0;
+        return value_.array_->size();
     case objectValue:
         return Int( value_.map_->size() );
     default:
@@ -735,9 +2095,12 @@ Value::clear()
 {
     JSON_ASSERT( type_ == nullValue  ||  type_ == arrayValue  || type_ == objectValue );
 
+    unshare();
     switch ( type_ )
     {
     case arrayValue:
+        value_.array_->clear();
+        break;
     case objectValue:
         value_.map_->clear();
         break;
@@ -755,23 +2118,8 @@ Value::resize( UInt newSize )
          *this = Value(arrayValue);
     }
 
-    UInt oldSize = size();
-    if (newSize == 0)
-    {
-         clear();
-    }
-    else if (newSize > oldSize)
-    {
-         (*this)[newSize - 1];
-    }
-    else
-    {
-         for (UInt index = newSize; index < oldSize; ++index)
-         {
-              value_.map_->erase(index);
-         }
-        assert( size() == newSize );
-    }
+    unshare();
+    value_.array_->resize( newSize );
 }
 
 
@@ -784,16 +2132,12 @@ Value::operator[]( UInt index )
          *this = Value(arrayValue);
     }
 
-    CZString key( index );
-    ObjectValues::iterator it = value_.map_->lower_bound( key );
-    if (it != value_.map_->end() && (*it).first == key)
+    unshare();
+    if (index >= value_.array_->size())
     {
-         return (*it).second;
+         value_.array_->resize( index + 1 );
     }
-
-    ObjectValues::value_type defaultValue( key, null );
-    it = value_.map_->insert( it, defaultValue );
-    return (*it).second;
+    return (*value_.array_)[index];
 }
 
 
@@ -806,14 +2150,12 @@ Value::operator[]( UInt index ) const
          return null;
     }
 
-    CZString key( index );
-    ObjectValues::const_iterator it = value_.map_->find( key );
-    if (it == value_.map_->end())
+    if (index >= value_.array_->size())
     {
          return null;
     }
 
-    return (*it).second;
+    return (*value_.array_)[index];
 }
 
 
@@ -834,6 +2176,7 @@ Value::resolveReference( const char *key,
          *this = Value(objectValue);
     }
 
+    unshare();
     CZString actualKey( key, isStatic ? CZString::noDuplication  : CZString::duplicateOnCopy );
     ObjectValues::iterator it = value_.map_->lower_bound( actualKey );
     if (it != value_.map_->end() && (*it).first == actualKey)
@@ -841,13 +2184,31 @@ Value::resolveReference( const char *key,
          return (*it).second;
     }
 
-    ObjectValues::value_type defaultValue( actualKey, null );
-    it = value_.map_->insert( it, defaultValue );
+    it = value_.map_->insert( it, actualKey );
     Value &value = (*it).second;
     return value;
 }
 
 
+Value &
+Value::appendMember( const char *key, 
+                     bool isStatic )
+{
+    JSON_ASSERT( type_ == objectValue );
+    unshare();
+    CZString actualKey( key, isStatic ? CZString::noDuplication  : CZString::duplicateOnCopy );
+    return value_.map_->append( actualKey )->second;
+}
+
+
+bool 
+Value::sortMembers()
+{
+    JSON_ASSERT( type_ == objectValue );
+    return value_.map_->sort();
+}
+
+
 Value 
 Value::get( UInt index, 
                 const Value &defaultValue ) const
@@ -903,11 +2264,28 @@ Value::operator[]( const StaticString &key )
     return resolveReference( key, true );
 }
 
+// value may be an element of this array, which growing it frees, so it
+// is copied or moved out before the new element is made.
 Value &
 Value::append( const Value &value )
 {
-    return (*this)[size()] = value;
+    Value copy( value );
+    Value &element = (*this)[size()];
+    element.swap( copy );
+    return element;
+}
+
+# if defined(JSON_HAS_RVALUE_REFERENCES)
+Value &
+Value::append( Value &&value )
+{
+    Value moved;
+    moved.swap( value );
+    Value &element = (*this)[size()];
+    element.swap( moved );
+    return element;
 }
+# endif
 
 
 Value 
@@ -935,13 +2313,20 @@ Value::removeMember( const char* key )
          return null;
     }
 
+    unshare();
     CZString actualKey( key, CZString::noDuplication );
     ObjectValues::iterator it = value_.map_->find( actualKey );
     if (it == value_.map_->end())
     {
          return null;
     }
-    Value old(it->second);
+# if defined(JSON_HAS_RVALUE_REFERENCES)
+    Value old( std::move( it->second ) );
+# else
+    Value old;
+    old.swap( it->second );
+    old.takeComments( it->second );
+# endif
     value_.map_->erase(it);
     return old;
 }
@@ -1005,17 +2390,39 @@ Value::isBool() const
 bool 
 Value::isInt() const
 {
-    return type_ == intValue;
+    return ( type_ == intValue  &&  value_.int_ >= minInt  &&  value_.int_ <= maxInt )
+             ||  ( type_ == uintValue  &&  value_.uint_ <= LargestUInt(maxInt) );
 }
 
 
 bool 
 Value::isUInt() const
 {
-    return type_ == uintValue;
+    return ( type_ == intValue  &&  value_.int_ >= 0  &&  LargestUInt(value_.int_) <= maxUInt )
+             ||  ( type_ == uintValue  &&  value_.uint_ <= maxUInt );
+}
+
+
+# if defined(JSON_HAS_INT64)
+
+bool 
+Value::isInt64() const
+{
+    return type_ == intValue
+             ||  ( type_ == uintValue  &&  value_.uint_ <= LargestUInt(maxInt64) );
 }
 
 
+bool 
+Value::isUInt64() const
+{
+    return ( type_ == intValue  &&  value_.int_ >= 0 )
+             ||  type_ == uintValue;
+}
+
+# endif // if defined(JSON_HAS_INT64)
+
+
 bool 
 Value::isIntegral() const
 {
@@ -1060,16 +2467,12 @@ Value::isObject() const
 }
 
 
+# ifndef JSON_NO_COMMENTS
 void 
 Value::setComment( const char *comment,
                          CommentPlacement placement )
 {
-    if (!comments_)
-    {
-        comments_ = new CommentInfo[numberOfCommentPlacement];
-    }
-
-    comments_[placement].setComment( comment );
+    makeComments()[placement].setComment( comment );
 }
 
 
@@ -1084,19 +2487,22 @@ Value::setComment( const std::string &comment,
 bool 
 Value::hasComment( CommentPlacement placement ) const
 {
-    return comments_ != 0  &&  comments_[placement].comment_ != 0;
+    const CommentInfo *info = comments();
+    return info != 0  &&  info[placement].comment_ != 0;
 }
 
 std::string 
 Value::getComment( CommentPlacement placement ) const
 {
-    if (hasComment(placement))
+    const CommentInfo *info = comments();
+    if ( info != 0  &&  info[placement].comment_ != 0 )
     {
-        return comments_[placement].comment_;
+        return info[placement].comment_;
     }
 
     return "";
 }
+# endif
 
 
 std::string 
@@ -1113,6 +2519,7 @@ Value::begin() const
     switch ( type_ )
     {
     case arrayValue:
+        return const_iterator(value_.array_, 0);
     case objectValue:
         if (value_.map_)
         {
@@ -1131,6 +2538,7 @@ Value::end() const
     switch ( type_ )
     {
     case arrayValue:
+        return const_iterator(value_.array_, value_.array_->size());
     case objectValue:
          if (value_.map_)
          {
@@ -1147,9 +2555,11 @@ Value::end() const
 Value::iterator 
 Value::begin()
 {
+    unshare();
     switch ( type_ )
     {
     case arrayValue:
+        return iterator(value_.array_, 0);
     case objectValue:
          if (value_.map_)
          {
@@ -1165,9 +2575,11 @@ Value::begin()
 Value::iterator 
 Value::end()
 {
+    unshare();
     switch ( type_ )
     {
     case arrayValue:
+        return iterator(value_.array_, value_.array_->size());
     case objectValue:
          if (value_.map_)
          {
@@ -1370,6 +2782,26 @@ Path::resolve( const Value &root,
 }
 
 
+TapeView 
+Path::resolve( const TapeView &root ) const
+{
+    TapeView node = root;
+    for ( Args::const_iterator it = args_.begin(); it != args_.end()  &&  node.isValid(); ++it )
+    {
+        const PathArgument &arg = *it;
+        if ( arg.kind_ == PathArgument::kindIndex )
+        {
+            node = node[arg.index_];
+        }
+        else if ( arg.kind_ == PathArgument::kindKey )
+        {
+            node = node[arg.key_];
+        }
+    }
+    return node;
+}
+
+
 Value &
 Path::make( Value &root ) const
 {
@@ -1400,18 +2832,35 @@ Path::make( Value &root ) const
 }
 
 ValueIteratorBase::ValueIteratorBase()
+    : current_(0)
+    , array_(0)
+    , index_(0)
 {
 }
 
 
 ValueIteratorBase::ValueIteratorBase(const Value::ObjectValues::iterator &current)
     : current_(current)
+    , array_(0)
+    , index_(0)
+{
+}
+
+
+ValueIteratorBase::ValueIteratorBase(Value::ArrayValues *array, Value::ArrayIndex index)
+    : current_(0)
+    , array_(array)
+    , index_(index)
 {
 }
 
 Value &
 ValueIteratorBase::deref() const
 {
+    if (array_)
+    {
+        return (*array_)[index_];
+    }
     return current_->second;
 }
 
@@ -1419,6 +2868,11 @@ ValueIteratorBase::deref() const
 void
 ValueIteratorBase::increment()
 {
+    if (array_)
+    {
+        ++index_;
+        return;
+    }
     ++current_;
 }
 
@@ -1426,6 +2880,11 @@ ValueIteratorBase::increment()
 void
 ValueIteratorBase::decrement()
 {
+    if (array_)
+    {
+        --index_;
+        return;
+    }
     --current_;
 }
 
@@ -1433,6 +2892,10 @@ ValueIteratorBase::decrement()
 ValueIteratorBase::difference_type
 ValueIteratorBase::computeDistance(const SelfType &other) const
 {
+    if (array_)
+    {
+        return difference_type(other.index_ - index_);
+    }
     return difference_type(std::distance(current_, other.current_));
 }
 
@@ -1440,6 +2903,10 @@ ValueIteratorBase::computeDistance(const SelfType &other) const
 bool
 ValueIteratorBase::isEqual(const SelfType &other) const
 {
+    if (array_ || other.array_)
+    {
+        return array_ == other.array_  &&  index_ == other.index_;
+    }
     return current_ == other.current_;
 }
 
@@ -1448,12 +2915,18 @@ void
 ValueIteratorBase::copy(const SelfType &other)
 {
     current_ = other.current_;
+    array_ = other.array_;
+    index_ = other.index_;
 }
 
 
 Value
 ValueIteratorBase::key() const
 {
+    if (array_)
+    {
+        return Value(Value::Int(index_));
+    }
 
     const Value::CZString czstring = (*current_).first;
     if (czstring.c_str())
@@ -1472,11 +2945,9 @@ ValueIteratorBase::key() const
 Value::UInt
 ValueIteratorBase::index() const
 {
-
-    const Value::CZString czstring = (*current_).first;
-    if (!czstring.c_str())
+    if (array_)
     {
-        return czstring.index();
+        return index_;
     }
     return Value::UInt(-1);
 }
@@ -1485,10 +2956,28 @@ ValueIteratorBase::index() const
 const char *
 ValueIteratorBase::memberName() const
 {
+    if (array_)
+    {
+        return "";
+    }
     const char *name = (*current_).first.c_str();
     return name ? name : "";
 }
 
+
+const char *
+ValueIteratorBase::memberName( const char **end ) const
+{
+    if (array_  ||  !(*current_).first.c_str())
+    {
+        *end = "";
+        return *end;
+    }
+    const Value::CZString &name = (*current_).first;
+    *end = name.c_str() + name.length();
+    return name.c_str();
+}
+
 ValueConstIterator::ValueConstIterator()
 {
 }
@@ -1500,6 +2989,11 @@ ValueConstIterator::ValueConstIterator(const Value::ObjectValues::iterator &curr
 {
 }
 
+ValueConstIterator::ValueConstIterator(Value::ArrayValues *array, Value::ArrayIndex index)
+    : ValueIteratorBase(array, index)
+{
+}
+
 ValueConstIterator &
 ValueConstIterator::operator =(const ValueIteratorBase &other)
 {
@@ -1517,6 +3011,11 @@ ValueIterator::ValueIterator(const Value::ObjectValues::iterator &current)
 {
 }
 
+ValueIterator::ValueIterator(Value::ArrayValues *array, Value::ArrayIndex index)
+    : ValueIteratorBase(array, index)
+{
+}
+
 ValueIterator::ValueIterator(const ValueConstIterator &other)
     : ValueIteratorBase(other)
 {
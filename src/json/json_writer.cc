@@ -1,4 +1,6 @@
 #include "writer.h"
+#include "json_dtoa.h"
+#include "json_scanner.h"
 #include <utility>
 #include <assert.h>
 #include <stdio.h>
@@ -11,28 +13,25 @@
 
 namespace Json {
 
-static void uintToString( unsigned int value, 
+static void uintToString( LargestUInt value, 
                                   char *&current )
 {
     *--current = 0;
     do
     {
-        *--current = (value % 10) + '0';
+        *--current = char( value % 10 ) + '0';
         value /= 10;
     }
     while ( value != 0 );
 }
 
-std::string valueToString( Value::Int value )
+std::string valueToString( LargestInt value )
 {
     char buffer[32];
     char *current = buffer + sizeof(buffer);
     bool isNegative = value < 0;
-    if (isNegative)
-    {
-        value = -value;
-    }
-    uintToString( Value::UInt(value), current );
+    // Negate as unsigned so that minLargestInt does not overflow.
+    uintToString( isNegative ? 0 - LargestUInt(value) : LargestUInt(value), current );
     if (isNegative)
     {
         *--current = '-';
@@ -42,7 +41,7 @@ std::string valueToString( Value::Int value )
 }
 
 
-std::string valueToString( Value::UInt value )
+std::string valueToString( LargestUInt value )
 {
     char buffer[32];
     char *current = buffer + sizeof(buffer);
@@ -51,47 +50,40 @@ std::string valueToString( Value::UInt value )
     return current;
 }
 
-std::string valueToString( double value )
+# if defined(JSON_HAS_INT64)
+
+std::string valueToString( Int value )
 {
-    char buffer[32];
+    return valueToString( LargestInt(value) );
+}
+
+
+std::string valueToString( UInt value )
+{
+    return valueToString( LargestUInt(value) );
+}
 
+# endif
+
+static char *doubleToChars( double value, char *buffer )
+{
+    if ( value - value != 0 )
+    {
+        // Not finite: there is no JSON spelling, keep the C library's.
 #ifdef __STDC_SECURE_LIB__ 
-    sprintf_s(buffer, sizeof(buffer), "%#.16g", value); 
+        sprintf_s(buffer, 32, "%g", value); 
 #else    
-    sprintf(buffer, "%#.16g", value); 
+        sprintf(buffer, "%g", value); 
 #endif
-
-    char* ch = buffer + strlen(buffer) - 1;
-    if (*ch != '0') return buffer;
-    while(ch > buffer && *ch == '0')
-    {
-      --ch;
+        return buffer + strlen( buffer );
     }
-    char* last_nonzero = ch;
-    while(ch >= buffer)
-    {
-      switch(*ch)
-      {
-      case '0':
-      case '1':
-      case '2':
-      case '3':
-      case '4':
-      case '5':
-      case '6':
-      case '7':
-      case '8':
-      case '9':
-         --ch;
-         continue;
-      case '.':
-         *(last_nonzero+2) = '\0';
-         return buffer;
-      default:
-         return buffer;
-      }
-    }
-    return buffer;
+    return formatDouble( value, buffer );
+}
+
+std::string valueToString( double value )
+{
+    char buffer[32];
+    return std::string( buffer, doubleToChars( value, buffer ) );
 }
 
 
@@ -100,142 +92,326 @@ std::string valueToString( bool value )
     return value ? "true" : "false";
 }
 
-std::string valueToQuotedString( const char *value )
+// Output targets of the serialization helpers below, which are written
+// once against append() and instantiated for each of them.
+
+class StringSink
 {
-    if (strpbrk(value, "\"\\\b\f\n\r\t") == NULL)
+public:
+    explicit StringSink( std::string &document )
+        : document_( document )
     {
-        return std::string("\"") + value + "\"";
     }
-    unsigned maxsize = strlen(value)*2 + 3;
-    std::string result;
-    result.reserve(maxsize); 
-    result += "\"";
-    for (const char* c=value; *c != 0; ++c)
+
+    void append( const char *text, size_t length )
+    {
+        document_.append( text, length );
+    }
+
+    void append( char c )
+    {
+        document_ += c;
+    }
+
+private:
+    std::string &document_;
+};
+
+
+class CountingSink
+{
+public:
+    CountingSink()
+        : size_( 0 )
+    {
+    }
+
+    void append( const char *, size_t length )
+    {
+        size_ += length;
+    }
+
+    void append( char )
+    {
+        ++size_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+private:
+    size_t size_;
+};
+
+
+class BufferSink
+{
+public:
+    explicit BufferSink( char *buffer )
+        : current_( buffer )
+    {
+    }
+
+    void append( const char *text, size_t length )
     {
-        switch(*c)
+        memcpy( current_, text, length );
+        current_ += length;
+    }
+
+    void append( char c )
+    {
+        *current_++ = c;
+    }
+
+    char *current() const
+    {
+        return current_;
+    }
+
+private:
+    char *current_;
+};
+
+
+template <typename Sink>
+static void appendInteger( Sink &sink, LargestUInt value, bool isNegative )
+{
+    char buffer[32];
+    char *end = buffer + sizeof(buffer) - 1;
+    char *current = end + 1;
+    uintToString( value, current );
+    if ( isNegative )
+    {
+        *--current = '-';
+    }
+    sink.append( current, end - current );
+}
+
+
+// Copies runs that need no escaping in one append, found 16 bytes at a
+// time, and escapes the rest. Control characters without a short form
+// are written as \u00XX; bytes >= 0x80 pass through as UTF-8.
+template <typename Sink>
+static void appendQuotedString( Sink &sink, const char *value, size_t length )
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    const char *end = value + length;
+    sink.append( '"' );
+    for (;;)
+    {
+        const char *special = findEscapeChar( value, end );
+        sink.append( value, special - value );
+        if ( special == end )
         {
-            case '\"':
-            result += "\\\"";
             break;
-            case '\\':
-            result += "\\\\";
+        }
+        switch ( *special )
+        {
+        case '"':
+            sink.append( "\\\"", 2 );
+            break;
+        case '\\':
+            sink.append( "\\\\", 2 );
+            break;
+        case '\b':
+            sink.append( "\\b", 2 );
             break;
-            case '\b':
-            result += "\\b";
+        case '\f':
+            sink.append( "\\f", 2 );
             break;
-            case '\f':
-            result += "\\f";
+        case '\n':
+            sink.append( "\\n", 2 );
             break;
-            case '\n':
-            result += "\\n";
+        case '\r':
+            sink.append( "\\r", 2 );
             break;
-            case '\r':
-            result += "\\r";
+        case '\t':
+            sink.append( "\\t", 2 );
             break;
-            case '\t':
-            result += "\\t";
+        default:
+            {
+                char escape[6] = { '\\', 'u', '0', '0', 
+                                   hexDigits[(*special >> 4) & 0xf], 
+                                   hexDigits[*special & 0xf] };
+                sink.append( escape, 6 );
+            }
             break;
-            case '/':
-            default:
-                result += *c;
         }
+        value = special + 1;
     }
-    result += "\"";
-    return result;
-}
-
-
-Writer::~Writer()
-{
+    sink.append( '"' );
 }
 
 
-FastWriter::FastWriter()
-    : yamlCompatiblityEnabled_( false )
+template <typename Sink>
+static void appendQuotedString( Sink &sink, const char *value )
 {
+    appendQuotedString( sink, value, strlen( value ) );
 }
 
 
-void 
-FastWriter::enableYAMLCompatibility()
-{
-    yamlCompatiblityEnabled_ = true;
-}
-
-
-std::string 
-FastWriter::write( const Value &root )
+std::string valueToQuotedString( const char *value )
 {
-    document_ = "";
-    writeValue( root );
-    document_ += "\n";
-    return document_;
+    std::string result;
+    StringSink sink( result );
+    appendQuotedString( sink, value );
+    return result;
 }
 
 
-void 
-FastWriter::writeValue( const Value &value )
+template <typename Sink>
+static void writeFastValue( const Value &value, Sink &sink, bool yamlCompatible )
 {
     switch ( value.type() )
     {
     case nullValue:
-        document_ += "null";
+        sink.append( "null", 4 );
         break;
     case intValue:
-        document_ += valueToString( value.asInt() );
+        {
+            LargestInt integer = value.asLargestInt();
+            bool isNegative = integer < 0;
+            appendInteger( sink, isNegative ? 0 - LargestUInt(integer) : LargestUInt(integer), isNegative );
+        }
         break;
     case uintValue:
-        document_ += valueToString( value.asUInt() );
+        appendInteger( sink, value.asLargestUInt(), false );
         break;
     case realValue:
-        document_ += valueToString( value.asDouble() );
+        {
+            char buffer[32];
+            sink.append( buffer, doubleToChars( value.asDouble(), buffer ) - buffer );
+        }
         break;
     case stringValue:
-        document_ += valueToQuotedString( value.asCString() );
+        {
+            const char *begin;
+            const char *end;
+            value.getString( &begin, &end );
+            appendQuotedString( sink, begin, end - begin );
+        }
         break;
     case booleanValue:
-        document_ += valueToString( value.asBool() );
+        if ( value.asBool() )
+        {
+            sink.append( "true", 4 );
+        }
+        else
+        {
+            sink.append( "false", 5 );
+        }
         break;
     case arrayValue:
         {
-            document_ += "[";
-            int size = value.size();
-            for ( int index =0; index < size; ++index )
+            sink.append( '[' );
+            Value::UInt size = value.size();
+            for ( Value::UInt index = 0; index < size; ++index )
             {
-                 if (index > 0)
-                 {
-                      document_ += ",";
-                 }
-                writeValue( value[index] );
+                if ( index > 0 )
+                {
+                    sink.append( ',' );
+                }
+                writeFastValue( value[index], sink, yamlCompatible );
             }
-            document_ += "]";
+            sink.append( ']' );
         }
         break;
     case objectValue:
         {
-            Value::Members members( value.getMemberNames() );
-            document_ += "{";
-            for ( Value::Members::iterator it = members.begin(); 
-                    it != members.end(); 
-                    ++it )
+            sink.append( '{' );
+            Value::const_iterator begin = value.begin();
+            Value::const_iterator end = value.end();
+            for ( Value::const_iterator it = begin; it != end; ++it )
             {
-                const std::string &name = *it;
-                if (it != members.begin())
+                if ( it != begin )
+                {
+                    sink.append( ',' );
+                }
+                const char *nameEnd;
+                const char *name = it.memberName( &nameEnd );
+                appendQuotedString( sink, name, nameEnd - name );
+                if ( yamlCompatible )
                 {
-                     document_ += ",";
+                    sink.append( ": ", 2 );
                 }
-                document_ += valueToQuotedString( name.c_str() );
-                document_ += yamlCompatiblityEnabled_ ? ": " 
-                                                                  : ":";
-                writeValue( value[name] );
+                else
+                {
+                    sink.append( ':' );
+                }
+                writeFastValue( *it, sink, yamlCompatible );
             }
-            document_ += "}";
+            sink.append( '}' );
         }
         break;
     }
 }
 
 
+Writer::~Writer()
+{
+}
+
+
+FastWriter::FastWriter()
+    : yamlCompatiblityEnabled_( false )
+{
+}
+
+
+void 
+FastWriter::enableYAMLCompatibility()
+{
+    yamlCompatiblityEnabled_ = true;
+}
+
+
+std::string 
+FastWriter::write( const Value &root )
+{
+    document_.clear();
+    write( root, document_ );
+    return document_;
+}
+
+
+void 
+FastWriter::write( const Value &root, std::string &document ) const
+{
+    StringSink sink( document );
+    writeFastValue( root, sink, yamlCompatiblityEnabled_ );
+    sink.append( '\n' );
+}
+
+
+size_t 
+FastWriter::computeSize( const Value &root ) const
+{
+    CountingSink sink;
+    writeFastValue( root, sink, yamlCompatiblityEnabled_ );
+    return sink.size() + 1;
+}
+
+
+char *
+FastWriter::write( const Value &root, char *buffer ) const
+{
+    BufferSink sink( buffer );
+    writeFastValue( root, sink, yamlCompatiblityEnabled_ );
+    sink.append( '\n' );
+    return sink.current();
+}
+
+
+void 
+FastWriter::writeValue( const Value &value )
+{
+    StringSink sink( document_ );
+    writeFastValue( value, sink, yamlCompatiblityEnabled_ );
+}
+
+
 StyledWriter::StyledWriter()
     : rightMargin_( 74 )
     , indentSize_( 3 )
@@ -266,10 +442,10 @@ StyledWriter::writeValue( const Value &value )
         pushValue( "null" );
         break;
     case intValue:
-        pushValue( valueToString( value.asInt() ) );
+        pushValue( valueToString( value.asLargestInt() ) );
         break;
     case uintValue:
-        pushValue( valueToString( value.asUInt() ) );
+        pushValue( valueToString( value.asLargestUInt() ) );
         break;
     case realValue:
         pushValue( valueToString( value.asDouble() ) );
@@ -285,8 +461,9 @@ StyledWriter::writeValue( const Value &value )
         break;
     case objectValue:
         {
-            Value::Members members( value.getMemberNames() );
-            if (members.empty())
+            Value::const_iterator it = value.begin();
+            Value::const_iterator end = value.end();
+            if ( it == end )
             {
                  pushValue("{}");
             }
@@ -294,16 +471,14 @@ StyledWriter::writeValue( const Value &value )
             {
                 writeWithIndent( "{" );
                 indent();
-                Value::Members::iterator it = members.begin();
                 while ( true )
                 {
-                    const std::string &name = *it;
-                    const Value &childValue = value[name];
+                    const Value &childValue = *it;
                     writeCommentBeforeValue( childValue );
-                    writeWithIndent( valueToQuotedString( name.c_str() ) );
+                    writeWithIndent( valueToQuotedString( it.memberName() ) );
                     document_ += " : ";
                     writeValue( childValue );
-                    if ( ++it == members.end() )
+                    if ( ++it == end )
                     {
                         writeCommentAfterValueOnSameLine( childValue );
                         break;
@@ -562,10 +737,10 @@ StyledStreamWriter::writeValue( const Value &value )
         pushValue( "null" );
         break;
     case intValue:
-        pushValue( valueToString( value.asInt() ) );
+        pushValue( valueToString( value.asLargestInt() ) );
         break;
     case uintValue:
-        pushValue( valueToString( value.asUInt() ) );
+        pushValue( valueToString( value.asLargestUInt() ) );
         break;
     case realValue:
         pushValue( valueToString( value.asDouble() ) );
@@ -581,8 +756,9 @@ StyledStreamWriter::writeValue( const Value &value )
         break;
     case objectValue:
         {
-            Value::Members members( value.getMemberNames() );
-            if (members.empty())
+            Value::const_iterator it = value.begin();
+            Value::const_iterator end = value.end();
+            if ( it == end )
             {
                  pushValue("{}");
             }
@@ -590,16 +766,14 @@ StyledStreamWriter::writeValue( const Value &value )
             {
                 writeWithIndent( "{" );
                 indent();
-                Value::Members::iterator it = members.begin();
                 while ( true )
                 {
-                    const std::string &name = *it;
-                    const Value &childValue = value[name];
+                    const Value &childValue = *it;
                     writeCommentBeforeValue( childValue );
-                    writeWithIndent( valueToQuotedString( name.c_str() ) );
+                    writeWithIndent( valueToQuotedString( it.memberName() ) );
                     *document_ << " : ";
                     writeValue( childValue );
-                    if ( ++it == members.end() )
+                    if ( ++it == end )
                     {
                         writeCommentAfterValueOnSameLine( childValue );
                         break;
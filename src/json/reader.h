@@ -4,7 +4,7 @@
 # include "forwards.h"
 # include "value.h"
 # include <deque>
-# include <stack>
+# include <vector>
 # include <string>
 # include <iostream>
 
@@ -12,12 +12,53 @@ namespace Json {
 
     class Value;
 
+    /// Receives the values of a document as Reader reads them, without
+    /// building a Value tree. Returning false from a callback stops parsing.
+    class JSON_API ReaderHandler
+    {
+    public:
+        virtual ~ReaderHandler();
+
+        virtual bool onNull();
+        virtual bool onBool( bool value );
+        virtual bool onInt( Value::LargestInt value );
+        virtual bool onUInt( Value::LargestUInt value );
+        virtual bool onDouble( double value );
+        virtual bool onString( const char *value, unsigned int length );
+        virtual bool onStartObject();
+        virtual bool onKey( const char *name, unsigned int length );
+        virtual bool onEndObject();
+        virtual bool onStartArray();
+        virtual bool onEndArray();
+    };
+
     class JSON_API Reader
     {
     public:
         typedef char Char;
         typedef const Char *Location;
 
+        enum ErrorCode
+        {
+            errorNone = 0,
+            errorValueExpected,
+            errorMissingObjectEnd,
+            errorMissingArrayEnd,
+            errorMissingMemberName,
+            errorMissingColon,
+            errorInvalidNumber,
+            errorEmptyEscape,
+            errorBadEscape,
+            errorSurrogateTooShort,
+            errorSurrogateExpected,
+            errorUnicodeTooShort,
+            errorUnicodeDigit,
+            errorStackLimit,
+            errorStoppedByHandler,
+            errorExtraData,
+            errorDocumentTooLarge
+        };
+
         Reader();
 
         bool parse( const std::string &document, 
@@ -34,6 +75,52 @@ namespace Json {
                         Value &root,
                         bool collectComments = true );
 
+        /// Parses a mutable buffer in place: strings are unescaped inside the
+        /// buffer and string values and member names point into it, so the
+        /// buffer must outlive root and every copy made of it. String
+        /// values holding \u0000 are copied out. Member names end at their
+        /// first zero here as in every other mode.
+        bool parseInsitu( char *beginDoc, char *endDoc, 
+                              Value &root,
+                              bool collectComments = true );
+
+        /// Reports the document to handler as a stream of events. Memory use
+        /// depends on the nesting depth only; comments are skipped.
+        bool parse( const char *beginDoc, const char *endDoc, 
+                        ReaderHandler &handler );
+
+        /// Indexes the document into tape without decoding it, for reading
+        /// a few values through tape.root(). Documents are limited to 4 GB.
+        bool parse( const char *beginDoc, const char *endDoc, 
+                        Tape &tape );
+
+        /// Builds the arrays, objects, strings and member names of the
+        /// following parses in allocator instead of allocating each of them
+        /// on the heap (0 returns to the heap). See ValueAllocator.
+        void setAllocator( ValueAllocator *allocator );
+
+        /// Takes the member names of the following parses from table, so
+        /// repeated keys share one copy (0 duplicates each name again).
+        void setMemberNameTable( MemberNameTable *table );
+
+        enum { defaultStackLimit = 1000 };
+
+        /// Rejects documents that nest arrays and objects more than limit
+        /// levels deep. The parser keeps its own stack; the limit protects
+        /// the code that walks the resulting tree recursively.
+        void setStackLimit( unsigned int limit );
+
+        /// In strict mode a parse stops at the first error instead of
+        /// skipping to the end of each enclosing array or object, and
+        /// comments or anything after the root value are errors.
+        void setStrictMode( bool strict );
+
+        /// The first error of the last parse, errorNone if there was none.
+        ErrorCode getErrorCode() const;
+
+        /// Byte offset of the token the first error was reported at.
+        size_t getErrorOffset() const;
+
         std::string getFormatedErrorMessages() const;
 
     private:
@@ -67,13 +154,36 @@ namespace Json {
         {
         public:
             Token token_;
-            std::string message_;
+            ErrorCode code_;
             Location extra_;
         };
 
         typedef std::deque<ErrorInfo> Errors;
 
-        bool expectToken( TokenType type, Token &token, const char *message );
+        /// A value being read; arrays and objects also record where they
+        /// stand, so that parsing does not recurse.
+        class Node
+        {
+        public:
+            Value *value_;
+            TokenType closer_;
+            Value::ArrayIndex index_;
+            bool emptyName_;
+        };
+
+        typedef std::vector<Node> Nodes;
+
+        enum Step
+        {
+            stepReadValue = 0,
+            stepEndValue,
+            stepError
+        };
+
+        bool readDocument( const char *beginDoc, const char *endDoc, 
+                                 Value &root,
+                                 bool collectComments );
+        bool expectToken( TokenType type, Token &token, ErrorCode code );
         bool readToken( Token &token );
         void skipSpaces();
         bool match( Location pattern, 
@@ -84,21 +194,49 @@ namespace Json {
         bool readString();
         void readNumber();
         bool readValue();
-        bool readObject( Token &token );
-        bool readArray( Token &token );
+        Step beginObject( Token &token );
+        Step readObjectMember();
+        Step readObjectSeparator();
+        Step beginArray( Token &token );
+        Step readArrayElement();
+        Step readArraySeparator();
+        void pushNode( Value *value, TokenType closer );
+        bool readValue( ReaderHandler &handler );
+        bool readObjectMember( Token &tokenName, ReaderHandler &handler );
+        bool readValue( Tape &tape );
+        bool readObjectMember( Token &tokenName, Tape &tape );
+        void addTapeEntry( Tape &tape, Location location );
+        bool startIndex();
+        bool indexNextWindow();
+        bool nextStructural( Location &position );
+        bool endsIndexedValue( Location location ) const;
+        bool matchIndexed( Location location, const char *literal, int length ) const;
+        bool readIndexedValue( Tape &tape );
+        bool readIndexedMember( Location position, Tape &tape );
+        bool addHandlerError( Token &token );
+        bool addStackLimitError( Token &token );
+        bool expectEndOfStream();
         bool decodeNumber( Token &token );
         bool decodeString( Token &token );
         bool decodeString( Token &token, std::string &decoded );
-        bool decodeDouble( Token &token );
+        bool decodeStringInPlace( Token &token, const Char *&decoded, size_t &length );
+        bool decodeStringInAllocator( Token &token, const Char *&decoded, size_t &length );
+        bool unescapeString( Token &token, Char *output, Char *&outputEnd );
+        bool decodeNumber( Token &token, Value &decoded );
+        bool decodeDouble( Token &token, Value &decoded );
+        bool decodeUnicodeCodePoint( Token &token, 
+                                              Location &current, 
+                                              Location end, 
+                                              unsigned int &unicode );
         bool decodeUnicodeEscapeSequence( Token &token, 
                                                      Location &current, 
                                                      Location end, 
                                                      unsigned int &unicode );
-        bool addError( const std::string &message, 
+        bool addError( ErrorCode code, 
                             Token &token,
                             Location extra = 0 );
         bool recoverFromError( TokenType skipUntilToken );
-        bool addErrorAndRecover( const std::string &message, 
+        bool addErrorAndRecover( ErrorCode code, 
                                          Token &token,
                                          TokenType skipUntilToken );
         void skipUntilSpace();
@@ -113,7 +251,6 @@ namespace Json {
                               CommentPlacement placement );
         void skipCommentTokens( Token &token );
     
-        typedef std::stack<Value *> Nodes;
         Nodes nodes_;
         Errors errors_;
         std::string document_;
@@ -124,6 +261,76 @@ namespace Json {
         Value *lastValue_;
         std::string commentsBefore_;
         bool collectComments_;
+        bool insitu_;
+        /// Large tapes are built from a structural index of the document,
+        /// made a window at a time; see readIndexedValue().
+        bool indexing_;
+        std::vector<unsigned int> structurals_;
+        size_t structural_;
+        size_t structuralCount_;
+        Location indexed_;
+        unsigned int indexCarries_;
+        ValueAllocator *allocator_;
+        MemberNameTable *memberNames_;
+        unsigned int stackLimit_;
+        bool strict_;
+        std::string decodedString_;
+    };
+
+    /// Parses a stream of top-level values that arrives in arbitrary chunks.
+    /// Input is buffered per top-level value: each byte is scanned once to
+    /// find where the value ends, and the value is then parsed from the
+    /// buffer, so it is read twice. A value waits in a queue for
+    /// getNextValue() as soon as it closes.
+    /// When comments are collected, the comments on the lines before a value
+    /// are kept with it, and so are those after it on its last line: the
+    /// value is parsed again with them, and getNextValue() only returns it at
+    /// the end of that line, the next value or finish(). Comments after the
+    /// last value's line are dropped.
+    class JSON_API IncrementalReader
+    {
+    public:
+        IncrementalReader( bool collectComments = false );
+
+        bool feed( const char *data, size_t length );
+        bool finish();
+        bool getNextValue( Value &root );
+        std::string getFormatedErrorMessages() const;
+
+    private:
+        enum State
+        {
+            stateIdle = 0,
+            stateScalar,
+            stateContainer,
+            stateString,
+            stateStringEscape,
+            stateCommentStart,
+            stateLineComment,
+            stateBlockComment,
+            stateBlockCommentEnd,
+            stateValueEnd
+        };
+
+        bool scan();
+        bool endValue( size_t end );
+        bool releaseValue( size_t end );
+        bool emitValue( size_t end );
+
+        Reader reader_;
+        std::string buffer_;
+        std::deque<Value> values_;
+        std::string errors_;
+        size_t scanned_;
+        size_t valueStart_;
+        int depth_;
+        State state_;
+        State commentReturnState_;
+        bool collectComments_;
+        bool leadingComments_;
+        bool holding_;
+        bool trailingComments_;
+        size_t heldStart_;
     };
 
     std::istream& operator>>( std::istream&, Value& );
@@ -0,0 +1,94 @@
+#ifndef CPPTL_JSON_TAPE_H_INCLUDED
+# define CPPTL_JSON_TAPE_H_INCLUDED
+
+# include "forwards.h"
+# include "value.h"
+# include <string>
+# include <vector>
+
+namespace Json {
+
+    /// Structural index of a document, filled by
+    /// Reader::parse( beginDoc, endDoc, tape ). It holds one entry per value
+    /// and member name: the offset of its first byte and the index of the
+    /// entry after it, which steps over a whole array or object. Nothing is
+    /// decoded while indexing; TapeView decodes what is accessed. Numbers
+    /// and escape sequences are only checked then, and a malformed one
+    /// reads as null. The document must outlive the tape and its views.
+    class JSON_API Tape
+    {
+    public:
+        Tape();
+
+        /// Invalid if the last parse failed.
+        TapeView root() const;
+
+        /// Number of entries, i.e. of values and member names.
+        size_t size() const;
+
+    private:
+        friend class Reader;
+        friend class TapeView;
+
+        struct Entry
+        {
+            unsigned int offset_;
+            unsigned int next_;
+        };
+
+        typedef std::vector<Entry> Entries;
+
+        Entries entries_;
+        const char *begin_;
+        const char *end_;
+    };
+
+    /// A value of a Tape, looked up and decoded on access. Views are cheap
+    /// to copy; a missing member or index gives an invalid view, which
+    /// reads as null.
+    class JSON_API TapeView
+    {
+    public:
+        TapeView();
+
+        bool isValid() const;
+        ValueType type() const;
+
+        /// Number of elements or members, counted by stepping over them.
+        Value::ArrayIndex size() const;
+        bool isMember( const char *key ) const;
+
+        TapeView operator[]( Value::ArrayIndex index ) const;
+        TapeView operator[]( const char *key ) const;
+        TapeView operator[]( const std::string &key ) const;
+
+        /// Decodes this value, and for arrays and objects everything in it.
+        Value asValue() const;
+        std::string asString() const;
+        Value::Int asInt() const;
+        Value::UInt asUInt() const;
+# if defined(JSON_HAS_INT64)
+        Value::Int64 asInt64() const;
+        Value::UInt64 asUInt64() const;
+# endif
+        Value::LargestInt asLargestInt() const;
+        Value::LargestUInt asLargestUInt() const;
+        double asDouble() const;
+        bool asBool() const;
+
+    private:
+        friend class Tape;
+
+        TapeView( const Tape *tape, unsigned int index );
+
+        const char *location() const;
+        TapeView findMember( const char *key, size_t length ) const;
+        bool nameEquals( unsigned int index, const char *key, size_t length ) const;
+
+        const Tape *tape_;
+        unsigned int index_;
+    };
+
+} // namespace Json
+
+#endif // CPPTL_JSON_TAPE_H_INCLUDED
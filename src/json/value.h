@@ -4,7 +4,7 @@
 # include "forwards.h"
 # include <string>
 # include <vector>
-# include <map>
+# include <utility>
 
 namespace Json {
 
@@ -53,13 +53,21 @@ namespace Json {
     class JSON_API Value 
     {
         friend class ValueIteratorBase;
+        friend class IncrementalReader;
+        friend class Reader;
 
     public:
 
         typedef std::vector<std::string> Members;
 
-        typedef int Int;
-        typedef unsigned int UInt;
+        typedef Json::Int Int;
+        typedef Json::UInt UInt;
+# if defined(JSON_HAS_INT64)
+        typedef Json::Int64 Int64;
+        typedef Json::UInt64 UInt64;
+# endif
+        typedef Json::LargestInt LargestInt;
+        typedef Json::LargestUInt LargestUInt;
         typedef ValueIterator iterator;
         typedef ValueConstIterator const_iterator;
         typedef UInt ArrayIndex;
@@ -68,6 +76,14 @@ namespace Json {
         static const Int minInt;
         static const Int maxInt;
         static const UInt maxUInt;
+# if defined(JSON_HAS_INT64)
+        static const Int64 minInt64;
+        static const Int64 maxInt64;
+        static const UInt64 maxUInt64;
+# endif
+        static const LargestInt minLargestInt;
+        static const LargestInt maxLargestInt;
+        static const LargestUInt maxLargestUInt;
 
     private:
 
@@ -84,41 +100,78 @@ namespace Json {
             CZString( int index );
             CZString( const char *cstr, DuplicationPolicy allocate );
             CZString( const CZString &other );
+# if defined(JSON_HAS_RVALUE_REFERENCES)
+            CZString( CZString &&other );
+# endif
             ~CZString();
 
             CZString &operator =( const CZString &other );
+# if defined(JSON_HAS_RVALUE_REFERENCES)
+            CZString &operator =( CZString &&other );
+# endif
             bool operator<( const CZString &other ) const;
             bool operator==( const CZString &other ) const;
             int index() const;
 
             const char *c_str() const;
+            size_t length() const;
             bool isStaticString() const;
-        private:
             void swap( CZString &other );
+        private:
+            enum { inlineName = -1 };
+            enum { inlineNameSize = sizeof(const char *) + 4 };
+
+            void setName( const char *name, size_t length );
+            char *inlineChars();
+
             const char *cstr_;
+            /// Owned names shorter than inlineNameSize are stored in place,
+            /// starting in cstr_ and running on into these bytes; index_ is
+            /// then inlineName.
+            char inlineNameTail_[4];
             int index_;
         };
 
     public:
 
-        typedef std::map<CZString, Value> ObjectValues;
+        class ObjectValues;
+        class ArrayValues;
 
     public:
       
         Value( ValueType type = nullValue );
 
+        /// Empty array or object whose storage grows inside allocator
+        /// rather than on the heap (0 selects the heap). See ValueAllocator.
+        Value( ValueType type, ValueAllocator *allocator );
+
         Value( Int value );
         Value( UInt value );
+# if defined(JSON_HAS_INT64)
+        Value( Int64 value );
+        Value( UInt64 value );
+# endif
         Value( double value );
         Value( const char *value );
       
         Value( const StaticString &value );
+        /// Copies value. There is no Value( std::string&& ): strings are
+        /// stored inline or in a malloc'd buffer of their own, which cannot
+        /// adopt a std::string's, so that overload would copy as well.
         Value( const std::string &value );
         Value( bool value );
         Value( const Value &other );
+# if defined(JSON_HAS_RVALUE_REFERENCES)
+        /// Takes over other's payload and comments; other is left null.
+        Value( Value &&other );
+# endif
         ~Value();
 
         Value &operator=( const Value &other );
+# if defined(JSON_HAS_RVALUE_REFERENCES)
+        /// Like copy assignment, keeps this value's comments; other is left null.
+        Value &operator=( Value &&other );
+# endif
 
         void swap( Value &other );
 
@@ -135,17 +188,33 @@ namespace Json {
         int compare( const Value &other );
 
         const char *asCString() const;
+        /// Bounds of a string value without measuring it; false for
+        /// other types.
+        bool getString( const char **begin, const char **end ) const;
         std::string asString() const;
 
         Int asInt() const;
         UInt asUInt() const;
+# if defined(JSON_HAS_INT64)
+        Int64 asInt64() const;
+        UInt64 asUInt64() const;
+# endif
+        LargestInt asLargestInt() const;
+        LargestUInt asLargestUInt() const;
         double asDouble() const;
         bool asBool() const;
 
         bool isNull() const;
         bool isBool() const;
+        /// Whether the value is an integer, of either type, that asInt()
+        /// or asUInt() returns without leaving its range.
         bool isInt() const;
         bool isUInt() const;
+# if defined(JSON_HAS_INT64)
+        /// As isInt() and isUInt(), for asInt64() and asUInt64().
+        bool isInt64() const;
+        bool isUInt64() const;
+# endif
         bool isIntegral() const;
         bool isDouble() const;
         bool isNumeric() const;
@@ -173,8 +242,20 @@ namespace Json {
 
         bool isValidIndex( UInt index ) const;
 
+        /// Elements are stored contiguously: growing an array, by append(),
+        /// resize() or operator[] past the end, moves them and invalidates
+        /// references and pointers to them. append() itself accepts an
+        /// element of the same array.
         Value &append( const Value &value );
-
+# if defined(JSON_HAS_RVALUE_REFERENCES)
+        Value &append( Value &&value );
+# endif
+
+        /// Members are kept sorted in contiguous storage: adding or removing
+        /// one moves the members after it and invalidates references and
+        /// pointers to them, so o["a"] = o["b"] may read a moved member when
+        /// "a" is new. Adding members out of order costs O(size()) each;
+        /// Reader builds the objects it parses in O(n log n).
         Value &operator[]( const char *key );
         
         const Value &operator[]( const char *key ) const;
@@ -196,6 +277,15 @@ namespace Json {
 
         Members getMemberNames() const;
 
+# ifdef JSON_NO_COMMENTS
+        void setComment( const char *, CommentPlacement ) {}
+
+        void setComment( const std::string &, CommentPlacement ) {}
+
+        bool hasComment( CommentPlacement ) const { return false; }
+
+        std::string getComment( CommentPlacement ) const { return ""; }
+# else
         void setComment( const char *comment, CommentPlacement placement );
 
         void setComment( const std::string &comment, CommentPlacement placement );
@@ -203,6 +293,7 @@ namespace Json {
         bool hasComment( CommentPlacement placement ) const;
 
         std::string getComment( CommentPlacement placement ) const;
+# endif
 
         std::string toStyledString() const;
 
@@ -212,10 +303,33 @@ namespace Json {
         iterator begin();
         iterator end();
 
+        /// Arrays, objects and comments take their nodes from pools with a
+        /// cache per thread. This hands the calling thread's cached nodes
+        /// back to the shared pool at once, e.g. before a worker idles;
+        /// thread exit does the same.
+        static void releaseThreadCache();
+
+        /// Opts the arrays and objects of this tree into copy-on-write:
+        /// copies of them then share storage under an owner count, and a
+        /// shared container is cloned, one level at a time, only when a
+        /// non-const accessor reaches it. Shared trees may be copied and
+        /// read from any thread. References or iterators obtained before
+        /// the call must not be used to modify the tree afterwards.
+        /// Containers built in a ValueAllocator are always copied.
+        void share();
+
     private:
         Value &resolveReference( const char *key, bool isStatic );
+        /// Reader's way of building objects: appendMember() adds a member
+        /// without searching or keeping order, and sortMembers() restores
+        /// the order once the object is complete.
+        Value &appendMember( const char *key, bool isStatic );
+        bool sortMembers();
+        void unshare();
+        void swapWithComments( Value &other );
 
     private:
+# ifndef JSON_NO_COMMENTS
         struct CommentInfo
         {
             CommentInfo();
@@ -225,21 +339,145 @@ namespace Json {
             char *comment_;
         };
 
+        struct CommentTable;
+
+        static CommentInfo *allocateComments();
+        static void releaseComments( CommentInfo *comments );
+        static CommentTable &commentTable();
+        CommentInfo *comments() const;
+        CommentInfo *makeComments();
+# endif
+        void dropComments();
+        void takeComments( Value &other );
+
+        enum { inlineStringSize = 14 };
+
+        void setString( const char *value, size_t length );
+        const char *stringData() const;
+        size_t stringLength() const;
+        char *inlineChars();
+
         union ValueHolder
         {
-            Int int_;
-            UInt uint_;
+            LargestInt int_;
+            LargestUInt uint_;
             double real_;
             bool bool_;
             char *string_;
+            ArrayValues *array_;
             ObjectValues *map_;
 
         } value_;
 
-        ValueType type_ : 8;
-        int allocated_ : 1;  
+        /// Strings shorter than inlineStringSize are stored in place,
+        /// starting in value_ and running on into these bytes.
+        char inlineStringTail_[inlineStringSize - sizeof(ValueHolder)];
+        unsigned char type_;
+        unsigned char allocated_ : 1;
+        unsigned char inlineString_ : 1;
+        /// Comments live in a side table keyed by the node's address.
+        unsigned char hasComments_ : 1;
+        unsigned char inlineLength_ : 4;
+    };
+
+    /// Contiguous storage of the elements of an arrayValue.
+    class Value::ArrayValues
+    {
+    public:
+        typedef Value *iterator;
+        typedef const Value *const_iterator;
+
+        explicit ArrayValues( ValueAllocator *allocator = 0 );
+        ArrayValues( const ArrayValues &other );
+        ~ArrayValues();
 
-        CommentInfo *comments_;
+        ValueAllocator *allocator() const;
+        /// Owners of a container opted in by Value::share(), or 0 for an
+        /// ordinary, uniquely owned one. Copies start at 0.
+        volatile long &shareCount();
+
+        ArrayIndex size() const;
+        bool empty() const;
+
+        Value &operator[]( ArrayIndex index );
+        const Value &operator[]( ArrayIndex index ) const;
+
+        void resize( ArrayIndex newSize );
+        void reserve( ArrayIndex newCapacity );
+        void clear();
+
+        iterator begin();
+        iterator end();
+        const_iterator begin() const;
+        const_iterator end() const;
+
+    private:
+        ArrayValues &operator =( const ArrayValues &other );
+
+        Value *values_;
+        ArrayIndex size_;
+        ArrayIndex capacity_;
+        ValueAllocator *allocator_;
+        volatile long shareCount_;
+    };
+
+    /// Members of an objectValue, sorted by name in one contiguous buffer.
+    /// Small objects keep their members inline, without a second allocation.
+    class Value::ObjectValues
+    {
+    public:
+        typedef std::pair<CZString, Value> value_type;
+        typedef value_type *iterator;
+        typedef const value_type *const_iterator;
+
+        enum { inlineCapacity = 4 };
+
+        explicit ObjectValues( ValueAllocator *allocator = 0 );
+        ObjectValues( const ObjectValues &other );
+        ~ObjectValues();
+
+        ValueAllocator *allocator() const;
+        /// See ArrayValues::shareCount().
+        volatile long &shareCount();
+
+        ArrayIndex size() const;
+        bool empty() const;
+
+        iterator find( const CZString &key );
+        const_iterator find( const CZString &key ) const;
+        iterator lower_bound( const CZString &key );
+        const_iterator lower_bound( const CZString &key ) const;
+
+        iterator insert( iterator position, const CZString &key );
+        iterator append( const CZString &key );
+        bool sort();
+        void erase( iterator position );
+        void clear();
+
+        iterator begin();
+        iterator end();
+        const_iterator begin() const;
+        const_iterator end() const;
+
+    private:
+        ObjectValues &operator =( const ObjectValues &other );
+
+        void reserve( ArrayIndex newCapacity );
+        bool isInline() const;
+        bool canRelocate( ArrayIndex first, ArrayIndex last ) const;
+        static void swapMembers( value_type &a, value_type &b );
+
+        value_type *members_;
+        ArrayIndex size_;
+        ArrayIndex capacity_;
+        ValueAllocator *allocator_;
+        volatile long shareCount_;
+        union InlineStorage
+        {
+            double alignDouble_;
+            void *alignPointer_;
+            char buffer_[sizeof(value_type) * inlineCapacity];
+        } inline_;
     };
 
     class PathArgument
@@ -279,6 +517,9 @@ namespace Json {
 
         const Value &resolve( const Value &root ) const;
         Value resolve( const Value &root, const Value &defaultValue ) const;
+        /// Walks the tape without decoding anything on the way; an invalid
+        /// view if the path does not exist.
+        TapeView resolve( const TapeView &root ) const;
         Value &make( Value &root ) const;
 
     private:
@@ -297,17 +538,78 @@ namespace Json {
         Args args_;
     };
 
-    class ValueAllocator
+    /// Memory strategy for a Value tree, chosen per tree with
+    /// Value( type, allocator ) or per Reader with Reader::setAllocator().
+    /// Containers created with an allocator grow inside it, and so do the
+    /// strings and member names a Reader decodes into them. None of that
+    /// memory is handed back one piece at a time: destroying such a tree
+    /// frees nothing, and the allocator reclaims everything at once, so it
+    /// must outlive the trees built with it. Copies made from those trees
+    /// are ordinary heap values. Trees without an allocator use malloc and
+    /// the shared node pools directly, with no virtual call.
+    class JSON_API ValueAllocator
     {
     public:
-        enum { unknown = (unsigned)-1 };
-
         virtual ~ValueAllocator();
 
-        virtual char *makeMemberName( const char *memberName ) = 0;
-        virtual void releaseMemberName( char *memberName ) = 0;
-        virtual char *duplicateStringValue( const char *value, unsigned int length = unknown ) = 0;
-        virtual void releaseStringValue( char *value ) = 0;
+        virtual void *allocate( size_t size ) = 0;
+
+        char *duplicate( const char *value, size_t length );
+    };
+
+    /// Monotonic ValueAllocator: carves allocations from large blocks,
+    /// and release() hands all blocks back at once.
+    class JSON_API ValueArena : public ValueAllocator
+    {
+    public:
+        enum { defaultBlockSize = 64 * 1024 };
+
+        explicit ValueArena( size_t blockSize = defaultBlockSize );
+        virtual ~ValueArena();
+
+        virtual void *allocate( size_t size );
+        void release();
+
+    private:
+        ValueArena( const ValueArena &other );
+        ValueArena &operator =( const ValueArena &other );
+
+        void *allocateBlock( size_t size );
+
+        struct Block;
+        Block *blocks_;
+        char *current_;
+        char *end_;
+        size_t blockSize_;
+    };
+
+    /// Interned member names shared by any number of documents and threads.
+    /// intern() returns a single stable copy of each distinct name; names
+    /// already in the table are found without taking a lock. Objects whose
+    /// keys come from the table (see Reader::setMemberNameTable) hold no
+    /// copy of their own. That saves memory and allocations, not lookups:
+    /// members stay sorted by name, so finding one still compares strings,
+    /// even by an interned pointer. The table only grows and must outlive
+    /// every value using its names.
+    class JSON_API MemberNameTable
+    {
+    public:
+        enum { defaultBucketCount = 1024 };
+
+        explicit MemberNameTable( size_t bucketCount = defaultBucketCount );
+        ~MemberNameTable();
+
+        const char *intern( const char *name );
+        const char *intern( const char *name, size_t length );
+        size_t size() const;
+
+    private:
+        MemberNameTable( const MemberNameTable &other );
+        MemberNameTable &operator =( const MemberNameTable &other );
+
+        struct Entry;
+        struct Table;
+        Table *table_;
     };
 
     class ValueIteratorBase
@@ -321,6 +623,8 @@ namespace Json {
 
         explicit ValueIteratorBase( const Value::ObjectValues::iterator &current );
 
+        ValueIteratorBase( Value::ArrayValues *array, Value::ArrayIndex index );
+
         bool operator ==( const SelfType &other ) const
         {
             return isEqual( other );
@@ -341,6 +645,8 @@ namespace Json {
         Value::UInt index() const;
 
         const char *memberName() const;
+        /// As memberName(), also setting end past its last character.
+        const char *memberName( const char **end ) const;
 
     protected:
         Value &deref() const;
@@ -358,7 +664,8 @@ namespace Json {
     private:
 
         Value::ObjectValues::iterator current_;
-
+        Value::ArrayValues *array_;
+        Value::ArrayIndex index_;
     };
 
     class ValueConstIterator : public ValueIteratorBase
@@ -376,6 +683,7 @@ namespace Json {
     private:
 
         explicit ValueConstIterator( const Value::ObjectValues::iterator &current );
+        ValueConstIterator( Value::ArrayValues *array, Value::ArrayIndex index );
 
     public:
         SelfType &operator =( const ValueIteratorBase &other );
@@ -429,6 +737,7 @@ namespace Json {
     private:
 
         explicit ValueIterator( const Value::ObjectValues::iterator &current );
+        ValueIterator( Value::ArrayValues *array, Value::ArrayIndex index );
 
     public:
 
@@ -28,6 +28,16 @@ namespace Json {
         virtual std::string write( const Value &root );
         void writeValue(const Value &value);
 
+        /// Appends the document for root to document, reusing its capacity.
+        void write( const Value &root, std::string &document ) const;
+
+        /// Exact number of bytes write( root, buffer ) produces.
+        size_t computeSize( const Value &root ) const;
+
+        /// Writes the document into buffer, which must hold computeSize( root )
+        /// bytes. Returns the end of the output; no terminating zero is added.
+        char *write( const Value &root, char *buffer ) const;
+
     private:
 
         std::string document_;
@@ -109,8 +119,12 @@ namespace Json {
         bool addChildValues_;
     };
 
-    std::string JSON_API valueToString( Value::Int value );
-    std::string JSON_API valueToString( Value::UInt value );
+    std::string JSON_API valueToString( LargestInt value );
+    std::string JSON_API valueToString( LargestUInt value );
+# if defined(JSON_HAS_INT64)
+    std::string JSON_API valueToString( Int value );
+    std::string JSON_API valueToString( UInt value );
+# endif
     std::string JSON_API valueToString( double value );
     std::string JSON_API valueToString( bool value );
     std::string JSON_API valueToQuotedString( const char *value );
@@ -0,0 +1,705 @@
+// Benchmarks of the json library. Run json_bench for timings, with the
+// names of the cases to run as arguments, or none for all of them; use a
+// Release build. "--quick" runs every case once on small inputs, which is
+// what ctest does to keep this file compiling and working.
+#include <json/json.h>
+#include <json/json_scanner.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static bool quick = false;
+
+// Counts heap allocations, the bytes they request and the bytes held,
+// the library's malloc calls and operator new alike, by interposing the
+// C allocator. Only glibc builds can count. heldBytes may wrap when
+// memory glibc allocated internally is freed; differences stay exact.
+static size_t allocations = 0;
+static size_t allocatedBytes = 0;
+static size_t heldBytes = 0;
+
+#if defined(__GLIBC__)
+# include <malloc.h>
+# define JSON_BENCH_COUNTS_ALLOCATIONS
+extern "C" void *__libc_malloc( size_t size );
+extern "C" void *__libc_calloc( size_t count, size_t size );
+extern "C" void *__libc_realloc( void *block, size_t size );
+extern "C" void __libc_free( void *block );
+
+static void *
+counted( void *block, size_t size )
+{
+    ++allocations;
+    allocatedBytes += size;
+    heldBytes += block ? malloc_usable_size( block ) : 0;
+    return block;
+}
+
+extern "C" void *
+malloc( size_t size ) throw()
+{
+    return counted( __libc_malloc( size ), size );
+}
+
+extern "C" void *
+calloc( size_t count, size_t size ) throw()
+{
+    return counted( __libc_calloc( count, size ), count * size );
+}
+
+extern "C" void *
+realloc( void *block, size_t size ) throw()
+{
+    heldBytes -= block ? malloc_usable_size( block ) : 0;
+    return counted( __libc_realloc( block, size ), size );
+}
+
+extern "C" void
+free( void *block ) throw()
+{
+    heldBytes -= block ? malloc_usable_size( block ) : 0;
+    __libc_free( block );
+}
+#endif
+
+// Keeps results alive so the timed work is not optimized away.
+static volatile size_t sink;
+
+static double
+now()
+{
+    return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// Best time of a few runs, in seconds.
+template <typename Function>
+static double
+bestTime( Function function )
+{
+    double best = 1e30;
+    for ( int run = 0; run < (quick ? 1 : 5); ++run )
+    {
+        double start = now();
+        function();
+        double elapsed = now() - start;
+        if ( elapsed < best )
+        {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+
+// Records of a typical API payload, minified, about size bytes in all;
+// the same seed gives the same document.
+static std::string
+makeCorpus( size_t size, unsigned int seed = 1 )
+{
+    static const char *words[] = { "alpha", "beta", "gamma", "delta", "ok", "name", "status", "v",
+                                   "a longer descriptive string value here" };
+    std::mt19937 random( seed );
+    std::string corpus = "[";
+    for ( int record = 0; corpus.size() < size; ++record )
+    {
+        char buffer[256];
+        snprintf( buffer, sizeof(buffer), "%s{\"id\":%d,\"name\":\"%s\",\"score\":%.16g,\"tags\":[",
+                  record ? "," : "", record, words[random() % 9], double( random() ) / random.max() );
+        corpus += buffer;
+        for ( int tag = 0; tag < 4; ++tag )
+        {
+            corpus += tag ? ",\"" : "\"";
+            corpus += words[random() % 9];
+            corpus += "\"";
+        }
+        snprintf( buffer, sizeof(buffer), "],\"active\":%s,\"meta\":{\"k\":\"%s\",\"n\":%u}}",
+                  random() % 2 ? "true" : "false", words[random() % 8], unsigned( random() % 1000 ) );
+        corpus += buffer;
+    }
+    return corpus + "]";
+}
+
+static std::string
+styled( const std::string &document )
+{
+    Json::Value root;
+    Json::Reader().parse( document, root, false );
+    return Json::StyledWriter().write( root );
+}
+
+struct NullHandler : Json::ReaderHandler
+{
+};
+
+static double
+megabytesPerSecond( size_t bytes, double seconds )
+{
+    return bytes / seconds / 1e6;
+}
+
+
+// Member lookup in objects of 4, 16 and 1000 members, against the
+// std::map the objects used to be.
+static void
+benchMemberLookup()
+{
+    static const int sizes[] = { 4, 16, 1000 };
+    for ( int size : sizes )
+    {
+        std::vector<std::string> keys;
+        Json::Value object( Json::objectValue );
+        std::map<std::string, Json::Value> map;
+        for ( int index = 0; index < size; ++index )
+        {
+            keys.push_back( "member" + std::to_string( index * 7919 % 10007 ) );
+            object[keys.back()] = index;
+            map[keys.back()] = index;
+        }
+        const Json::Value &constObject = object;
+        const size_t lookups = quick ? 1000 : 4000000;
+
+        double objectTime = bestTime( [&]() {
+            size_t total = 0;
+            for ( size_t lookup = 0; lookup < lookups; ++lookup )
+            {
+                total += constObject[keys[lookup % size].c_str()].asInt();
+            }
+            sink = total;
+        } );
+        double mapTime = bestTime( [&]() {
+            size_t total = 0;
+            for ( size_t lookup = 0; lookup < lookups; ++lookup )
+            {
+                total += map.find( keys[lookup % size] )->second.asInt();
+            }
+            sink = total;
+        } );
+        double iterationTime = bestTime( [&]() {
+            size_t total = 0;
+            for ( size_t pass = 0; pass < lookups / size; ++pass )
+            {
+                for ( Json::Value::const_iterator it = constObject.begin(); it != constObject.end(); ++it )
+                {
+                    total += (*it).asInt();
+                }
+            }
+            sink = total;
+        } );
+        double mapIterationTime = bestTime( [&]() {
+            size_t total = 0;
+            for ( size_t pass = 0; pass < lookups / size; ++pass )
+            {
+                for ( std::map<std::string, Json::Value>::const_iterator it = map.begin(); it != map.end(); ++it )
+                {
+                    total += it->second.asInt();
+                }
+            }
+            sink = total;
+        } );
+        double buildTime = bestTime( [&]() {
+            for ( size_t pass = 0; pass < lookups / size / 4; ++pass )
+            {
+                Json::Value built( Json::objectValue );
+                for ( int index = 0; index < size; ++index )
+                {
+                    built[keys[index]] = index;
+                }
+                sink = built.size();
+            }
+        } );
+        double mapBuildTime = bestTime( [&]() {
+            for ( size_t pass = 0; pass < lookups / size / 4; ++pass )
+            {
+                std::map<std::string, Json::Value> built;
+                for ( int index = 0; index < size; ++index )
+                {
+                    built[keys[index]] = index;
+                }
+                sink = built.size();
+            }
+        } );
+        double members = double( lookups / size * size );
+        printf( "lookup %4d members: build object %6.1f ns, std::map %6.1f ns per member\n",
+                size, buildTime * 1e9 * 4 / members, mapBuildTime * 1e9 * 4 / members );
+        printf( "lookup %4d members: find object %6.1f ns, std::map %6.1f ns; "
+                "iterate object %5.2f ns, std::map %5.2f ns per member\n",
+                size, objectTime * 1e9 / lookups, mapTime * 1e9 / lookups,
+                iterationTime * 1e9 / members, mapIterationTime * 1e9 / members );
+    }
+}
+
+
+// One large object parsed with its members in ascending, descending and
+// random order; the Reader sorts each object once it is complete.
+static void
+benchLargeObjects()
+{
+    int sizes[] = { 40000, 160000 };
+    for ( int size : sizes )
+    {
+        if ( quick )
+        {
+            size /= 100;
+        }
+        std::vector<int> keys( size );
+        for ( int index = 0; index < size; ++index )
+        {
+            keys[index] = index;
+        }
+        const char *orders[] = { "ascending", "descending", "random" };
+        for ( int order = 0; order < 3; ++order )
+        {
+            if ( order == 1 )
+            {
+                std::reverse( keys.begin(), keys.end() );
+            }
+            else if ( order == 2 )
+            {
+                std::shuffle( keys.begin(), keys.end(), std::mt19937( 2 ) );
+            }
+            std::string document = "{";
+            for ( int index = 0; index < size; ++index )
+            {
+                char member[32];
+                snprintf( member, sizeof(member), "%s\"member%07d\":%d", index ? "," : "", keys[index], index );
+                document += member;
+            }
+            document += "}";
+            double parseTime = bestTime( [&]() {
+                Json::Reader reader;
+                Json::Value root;
+                reader.parse( document, root, false );
+                sink = root.size();
+            } );
+            printf( "large %6d members, %-10s parse %8.2f ms\n", size, orders[order], parseTime * 1e3 );
+        }
+    }
+}
+
+
+// Reader throughput on minified and pretty-printed input, and the SSE2
+// scanners of json_scanner.h against plain byte loops.
+static void
+benchScanning()
+{
+    std::string minified = makeCorpus( quick ? 65536 : 32 << 20 );
+    std::string pretty = styled( minified );
+    const std::string *documents[] = { &minified, &pretty };
+    const char *names[] = { "minified", "styled" };
+    for ( int index = 0; index < 2; ++index )
+    {
+        const std::string &document = *documents[index];
+        double handlerTime = bestTime( [&]() {
+            Json::Reader reader;
+            NullHandler handler;
+            reader.parse( document.data(), document.data() + document.size(), handler );
+        } );
+        double treeTime = bestTime( [&]() {
+            Json::Reader reader;
+            Json::Value root;
+            reader.parse( document, root, false );
+        } );
+        printf( "scan  %-8s %6.1f MB: handler %6.0f MB/s, tree %6.0f MB/s\n", names[index], document.size() / 1e6,
+                megabytesPerSecond( document.size(), handlerTime ), megabytesPerSecond( document.size(), treeTime ) );
+    }
+
+    // Every run of spaces in the pretty-printed text, then every string
+    // body of a document of long strings.
+    const char *end = pretty.data() + pretty.size();
+    double skipTime = bestTime( [&]() {
+        size_t total = 0;
+        for ( const char *current = pretty.data(); current < end; ++current )
+        {
+            current = Json::skipSpaceChars( current, end );
+            total += *current;
+        }
+        sink = total;
+    } );
+    double skipLoopTime = bestTime( [&]() {
+        size_t total = 0;
+        for ( const char *current = pretty.data(); current < end; ++current )
+        {
+            while ( current != end  &&  Json::isJsonSpace( *current ) )
+            {
+                ++current;
+            }
+            total += *current;
+        }
+        sink = total;
+    } );
+    std::string strings;
+    while ( strings.size() < pretty.size() )
+    {
+        strings += "\"" + std::string( 200, 'x' ) + "\\n" + std::string( 100, 'y' ) + "\",";
+    }
+    const char *stringsEnd = strings.data() + strings.size();
+    double findTime = bestTime( [&]() {
+        size_t total = 0;
+        for ( const char *current = strings.data(); current < stringsEnd; ++current )
+        {
+            current = Json::findQuoteOrBackslash( current, stringsEnd );
+            total += *current;
+        }
+        sink = total;
+    } );
+    double findLoopTime = bestTime( [&]() {
+        size_t total = 0;
+        for ( const char *current = strings.data(); current < stringsEnd; ++current )
+        {
+            while ( current != stringsEnd  &&  *current != '"'  &&  *current != '\\' )
+            {
+                ++current;
+            }
+            total += *current;
+        }
+        sink = total;
+    } );
+    printf( "scan  spaces: skipSpaceChars %6.0f MB/s, byte loop %6.0f MB/s\n",
+            megabytesPerSecond( pretty.size(), skipTime ), megabytesPerSecond( pretty.size(), skipLoopTime ) );
+    printf( "scan  strings: findQuoteOrBackslash %6.0f MB/s, byte loop %6.0f MB/s\n",
+            megabytesPerSecond( strings.size(), findTime ), megabytesPerSecond( strings.size(), findLoopTime ) );
+}
+
+
+// Double formatting: valueToString (Grisu2) against sprintf("%.17g"), on
+// random bit patterns and on short decimals.
+static void
+benchDoubleFormat()
+{
+    std::mt19937_64 random( 8 );
+    std::vector<double> patterns, decimals;
+    size_t count = quick ? 1000 : 1000000;
+    while ( patterns.size() < count )
+    {
+        unsigned long long bits = random();
+        double value;
+        memcpy( &value, &bits, sizeof(double) );
+        if ( value == value  &&  value - value == 0 )
+        {
+            patterns.push_back( value );
+        }
+        decimals.push_back( double( random() % 1000000 ) / 1000 );
+    }
+    const std::vector<double> *inputs[] = { &patterns, &decimals };
+    const char *names[] = { "random bits", "decimals" };
+    for ( int index = 0; index < 2; ++index )
+    {
+        const std::vector<double> &values = *inputs[index];
+        double grisuTime = bestTime( [&]() {
+            size_t total = 0;
+            for ( double value : values )
+            {
+                total += Json::valueToString( value ).size();
+            }
+            sink = total;
+        } );
+        double sprintfTime = bestTime( [&]() {
+            size_t total = 0;
+            for ( double value : values )
+            {
+                char buffer[32];
+                total += std::string( buffer, snprintf( buffer, sizeof(buffer), "%.17g", value ) ).size();
+            }
+            sink = total;
+        } );
+        printf( "dtoa  %-12s valueToString %6.1f ns, sprintf %6.1f ns\n", names[index],
+                grisuTime * 1e9 / values.size(), sprintfTime * 1e9 / values.size() );
+    }
+}
+
+
+// Writers on one wide object, beside the getMemberNames() and lookup walk
+// the writers used to do for every object.
+static void
+benchWideObject()
+{
+    Json::Value object( Json::objectValue );
+    int size = quick ? 100 : 10000;
+    for ( int index = 0; index < size; ++index )
+    {
+        Json::Value &member = object["member" + std::to_string( index * 7919 % 10007 )];
+        member = index % 2 ? Json::Value( index ) : Json::Value( "text" );
+    }
+    const Json::Value &members = object;
+    double namesTime = bestTime( [&]() {
+        size_t total = 0;
+        Json::Value::Members names = members.getMemberNames();
+        for ( const std::string &name : names )
+        {
+            total += name.size() + members[name].type();
+        }
+        sink = total;
+    } );
+    double iteratorTime = bestTime( [&]() {
+        size_t total = 0;
+        for ( Json::Value::const_iterator it = members.begin(); it != members.end(); ++it )
+        {
+            total += strlen( it.memberName() ) + (*it).type();
+        }
+        sink = total;
+    } );
+    double fastTime = bestTime( [&]() {
+        Json::FastWriter writer;
+        sink = writer.write( object ).size();
+    } );
+    double styledTime = bestTime( [&]() {
+        Json::StyledWriter writer;
+        sink = writer.write( object ).size();
+    } );
+    double streamTime = bestTime( [&]() {
+        std::ostringstream out;
+        Json::StyledStreamWriter().write( out, object );
+        sink = out.str().size();
+    } );
+    printf( "wide  %d members, ns per member: names+lookup %.1f, iterators %.1f\n", size,
+            namesTime * 1e9 / size, iteratorTime * 1e9 / size );
+    printf( "wide  FastWriter %.1f, StyledWriter %.1f, StyledStreamWriter %.1f\n",
+            fastTime * 1e9 / size, styledTime * 1e9 / size, streamTime * 1e9 / size );
+}
+
+
+// Parse and teardown of whole trees on the heap and in a ValueArena, and
+// the heap allocations each makes.
+static void
+benchArena()
+{
+    std::string document = makeCorpus( quick ? 65536 : 270000 );
+    int runs = quick ? 1 : 50;
+    Json::ValueArena arena;
+    for ( int withArena = 0; withArena < 2; ++withArena )
+    {
+        double parseTime = 0, teardownTime = 0;
+        size_t parseAllocations = 0;
+        for ( int run = 0; run < runs; ++run )
+        {
+            Json::Reader reader;
+            if ( withArena )
+            {
+                reader.setAllocator( &arena );
+            }
+            Json::Value *root = new Json::Value;
+            size_t before = allocations;
+            double start = now();
+            reader.parse( document, *root, false );
+            double parsed = now();
+            parseAllocations = allocations - before;
+            delete root;
+            arena.release();
+            teardownTime += now() - parsed;
+            parseTime += parsed - start;
+        }
+        printf( "arena %-5s %.0f KB: parse %7.1f us, teardown %7.1f us", withArena ? "arena" : "heap",
+                document.size() / 1e3, parseTime * 1e6 / runs, teardownTime * 1e6 / runs );
+#ifdef JSON_BENCH_COUNTS_ALLOCATIONS
+        printf( ", %u allocations per parse", unsigned( parseAllocations ) );
+#endif
+        printf( "\n" );
+    }
+}
+
+
+// Objects of ten members drawn from a 200-name schema, parsed with and
+// without a MemberNameTable, then looked up by plain and interned names.
+static void
+benchInterning()
+{
+    std::vector<std::string> schema;
+    for ( int index = 0; index < 200; ++index )
+    {
+        schema.push_back( "schemaField" + std::to_string( index ) + "Name" );
+    }
+    std::mt19937 random( 16 );
+    std::string document = "[";
+    int objects = quick ? 200 : 20000;
+    for ( int object = 0; object < objects; ++object )
+    {
+        document += object ? ",{" : "{";
+        for ( int member = 0; member < 10; ++member )
+        {
+            document += member ? ",\"" : "\"";
+            document += schema[random() % schema.size()] + "\":" + std::to_string( random() % 1000 );
+        }
+        document += "}";
+    }
+    document += "]";
+
+    Json::MemberNameTable table;
+    Json::Value roots[2];
+    for ( int interned = 0; interned < 2; ++interned )
+    {
+        size_t parseAllocations = 0, parseBytes = 0;
+        double parseTime = bestTime( [&]() {
+            Json::Reader reader;
+            if ( interned )
+            {
+                reader.setMemberNameTable( &table );
+            }
+            Json::Value root;
+            size_t before = allocations, beforeBytes = allocatedBytes;
+            reader.parse( document, root, false );
+            parseAllocations = allocations - before;
+            parseBytes = allocatedBytes - beforeBytes;
+            roots[interned].swap( root );
+        } );
+        printf( "names %-8s %d objects: parse %6.2f ms", interned ? "interned" : "copied", objects, parseTime * 1e3 );
+#ifdef JSON_BENCH_COUNTS_ALLOCATIONS
+        printf( ", %u allocations, %.1f MB requested", unsigned( parseAllocations ), parseBytes / 1e6 );
+#endif
+        printf( "\n" );
+    }
+
+    // Every schema name looked up in every object of the interned tree.
+    std::vector<const char *> internedNames;
+    for ( const std::string &name : schema )
+    {
+        internedNames.push_back( table.intern( name.c_str() ) );
+    }
+    const Json::Value &root = roots[1];
+    for ( int byPointer = 0; byPointer < 2; ++byPointer )
+    {
+        double lookupTime = bestTime( [&]() {
+            size_t found = 0;
+            for ( Json::Value::ArrayIndex index = 0; index < root.size(); ++index )
+            {
+                const Json::Value &object = root[index];
+                for ( size_t name = 0; name < schema.size(); ++name )
+                {
+                    found += object.isMember( byPointer ? internedNames[name] : schema[name].c_str() );
+                }
+            }
+            sink = found;
+        } );
+        printf( "names lookup by %-8s %6.1f ns\n", byPointer ? "interned" : "string",
+                lookupTime * 1e9 / ( root.size() * schema.size() ) );
+    }
+}
+
+
+static size_t
+countValues( const Json::Value &value )
+{
+    size_t count = 1;
+    for ( Json::Value::const_iterator it = value.begin(); it != value.end(); ++it )
+    {
+        count += countValues( *it );
+    }
+    return count;
+}
+
+// Heap held by the tree of a parsed record corpus.
+static void
+benchMemory()
+{
+    std::string document = makeCorpus( quick ? 65536 : 32 << 20 );
+    Json::Reader reader;
+    Json::Value root;
+    size_t before = heldBytes;
+    reader.parse( document, root, false );
+    size_t held = heldBytes - before;
+    size_t values = countValues( root );
+    printf( "memory %.1f MB document, %.2f M values of %u bytes", document.size() / 1e6, values / 1e6,
+            unsigned( sizeof(Json::Value) ) );
+#ifdef JSON_BENCH_COUNTS_ALLOCATIONS
+    printf( ": tree holds %.1f MB, %.1f bytes per value", held / 1e6, double( held ) / values );
+#endif
+    printf( "\n" );
+    sink = held;
+}
+
+
+// Tree and handler parses of documents nested 400 levels deep, beside
+// the shallow record corpus of the same size.
+static void
+benchNesting()
+{
+    std::string deep = "[";
+    for ( int document = 0; deep.size() < ( quick ? 65536u : 8u << 20 ); ++document )
+    {
+        deep += document ? "," : "";
+        for ( int level = 0; level < 400; ++level )
+        {
+            deep += "[{\"a\":";
+        }
+        deep += "1";
+        for ( int level = 0; level < 400; ++level )
+        {
+            deep += "}]";
+        }
+    }
+    deep += "]";
+    std::string shallow = makeCorpus( deep.size() );
+    const std::string *documents[] = { &shallow, &deep };
+    const char *names[] = { "shallow", "deep" };
+    for ( int index = 0; index < 2; ++index )
+    {
+        const std::string &document = *documents[index];
+        double treeTime = bestTime( [&]() {
+            Json::Reader reader;
+            Json::Value root;
+            reader.parse( document, root, false );
+        } );
+        double handlerTime = bestTime( [&]() {
+            Json::Reader reader;
+            NullHandler handler;
+            reader.parse( document.data(), document.data() + document.size(), handler );
+        } );
+        printf( "nest  %-7s %5.1f MB: tree %6.0f MB/s, handler %6.0f MB/s\n", names[index], document.size() / 1e6,
+                megabytesPerSecond( document.size(), treeTime ), megabytesPerSecond( document.size(), handlerTime ) );
+    }
+}
+
+
+struct Case
+{
+    const char *name;
+    void (*run)();
+};
+
+static const Case cases[] = {
+    { "lookup", benchMemberLookup },
+    { "large", benchLargeObjects },
+    { "scan", benchScanning },
+    { "dtoa", benchDoubleFormat },
+    { "wide", benchWideObject },
+    { "arena", benchArena },
+    { "names", benchInterning },
+    { "memory", benchMemory },
+    { "nest", benchNesting },
+};
+
+int
+main( int argc, char *argv[] )
+{
+    std::vector<const char *> names;
+    for ( int arg = 1; arg < argc; ++arg )
+    {
+        if ( strcmp( argv[arg], "--quick" ) == 0 )
+        {
+            quick = true;
+        }
+        else
+        {
+            names.push_back( argv[arg] );
+        }
+    }
+    for ( const Case &benchCase : cases )
+    {
+        bool selected = names.empty();
+        for ( const char *name : names )
+        {
+            selected = selected  ||  strcmp( name, benchCase.name ) == 0;
+        }
+        if ( selected )
+        {
+            benchCase.run();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef JSON_TEST_H_INCLUDED
+# define JSON_TEST_H_INCLUDED
+
+# include <cstdio>
+
+// Checks of the json tests: a failed one is reported and counted, and the
+// test's main() returns testResult().
+
+static int testFailures = 0;
+
+# define JSON_CHECK( condition ) \
+    do \
+    { \
+        if ( !( condition ) ) \
+        { \
+            printf( "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition ); \
+            ++testFailures; \
+        } \
+    } while ( 0 )
+
+static inline int
+testResult()
+{
+    if ( testFailures == 0 )
+    {
+        printf( "all checks passed\n" );
+    }
+    return testFailures == 0 ? 0 : 1;
+}
+
+#endif // JSON_TEST_H_INCLUDED
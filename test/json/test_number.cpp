@@ -0,0 +1,212 @@
+// Number decoding: doubles must match strtod bit for bit, integers keep
+// their exact value, and malformed numbers are rejected.
+#include <json/json.h>
+#include "json_test.h"
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+static bool
+sameBits( double a, double b )
+{
+    return memcmp( &a, &b, sizeof(double) ) == 0;
+}
+
+// Decodes text as the single element of an array.
+static bool
+decode( const std::string &text, Json::Value &decoded )
+{
+    Json::Reader reader;
+    Json::Value root;
+    if ( !reader.parse( "[" + text + "]", root, false ) )
+    {
+        return false;
+    }
+    decoded = root[0u];
+    return true;
+}
+
+static void
+checkDouble( const std::string &text )
+{
+    Json::Value decoded;
+    JSON_CHECK( decode( text, decoded ) );
+    if ( !sameBits( decoded.asDouble(), strtod( text.c_str(), 0 ) ) )
+    {
+        printf( "%s decoded as %.17g\n", text.c_str(), decoded.asDouble() );
+        ++testFailures;
+    }
+}
+
+static void
+testKnownDoubles()
+{
+    const char *texts[] = {
+        "0.1", "-0.0", "1e23", "8.98846567431158e307", "1.7976931348623157e308",
+        "2.2250738585072011e-308", "2.2250738585072014e-308", "4.9e-324", "2.4703282292062328e-324",
+        "9007199254740993.0", "0.30000000000000004", "123456789012345678901234567890.5",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203124", "1e-400", "1e400",
+    };
+    for ( const char *text : texts )
+    {
+        checkDouble( text );
+    }
+}
+
+// Random decimal strings of up to 25 significant digits over the whole
+// exponent range, including ones that need the strtod fallback.
+static void
+testRandomDoubles()
+{
+    std::mt19937_64 random( 7 );
+    for ( int count = 0; count < 200000; ++count )
+    {
+        std::string text = random() % 2 ? "-" : "";
+        int digits = 1 + int( random() % 25 );
+        int point = int( random() % ( digits + 1 ) );
+        for ( int index = 0; index < digits; ++index )
+        {
+            if ( index == point  &&  index != 0 )
+            {
+                text += '.';
+            }
+            text += char( '0' + ( index == 0 ? 1 + random() % 9 : random() % 10 ) );
+        }
+        text += "e" + std::to_string( int( random() % 660 ) - 340 );
+        checkDouble( text );
+    }
+
+    // Shortest round-trip forms of random bit patterns.
+    for ( int count = 0; count < 200000; ++count )
+    {
+        unsigned long long bits = random();
+        double value;
+        memcpy( &value, &bits, sizeof(double) );
+        if ( value != value  ||  value - value != 0 )
+        {
+            continue;
+        }
+        char buffer[32];
+        snprintf( buffer, sizeof(buffer), "%.17g", value );
+        std::string text = buffer;
+        if ( text.find_first_of( ".e" ) == std::string::npos )
+        {
+            text += ".0";
+        }
+        checkDouble( text );
+    }
+}
+
+static void
+testIntegers()
+{
+    Json::Value decoded;
+    JSON_CHECK( decode( "0", decoded )  &&  decoded.isInt()  &&  decoded.asInt() == 0 );
+    JSON_CHECK( decode( "-0", decoded )  &&  decoded.isInt()  &&  decoded.asInt() == 0 );
+    JSON_CHECK( decode( "2147483647", decoded )  &&  decoded.asInt() == 2147483647 );
+    JSON_CHECK( decode( "4294967295", decoded )  &&  decoded.asUInt() == 4294967295u );
+    JSON_CHECK( decode( "-9223372036854775808", decoded )
+                &&  decoded.asLargestInt() == Json::Value::minLargestInt );
+    JSON_CHECK( decode( "18446744073709551615", decoded )
+                &&  decoded.asLargestUInt() == Json::Value::maxLargestUInt );
+    JSON_CHECK( decode( "18446744073709551616", decoded )  &&  decoded.isDouble()
+                &&  decoded.asDouble() == 18446744073709551616.0 );
+    JSON_CHECK( decode( "-9223372036854775809", decoded )  &&  decoded.isDouble() );
+}
+
+// The integer predicates hold exactly when the matching accessor returns
+// the value without leaving its range.
+static void
+testIntegerRanges()
+{
+    Json::Value decoded;
+    JSON_CHECK( decode( "1099511627776", decoded ) );
+    JSON_CHECK( !decoded.isInt()  &&  !decoded.isUInt()  &&  decoded.isIntegral() );
+    JSON_CHECK( !decoded.isConvertibleTo( Json::intValue ) );
+    JSON_CHECK( !decoded.isConvertibleTo( Json::uintValue ) );
+    JSON_CHECK( decoded.asLargestInt() == 1099511627776LL );
+    JSON_CHECK( decode( "-1099511627776", decoded ) );
+    JSON_CHECK( !decoded.isInt()  &&  !decoded.isUInt()  &&  !decoded.isConvertibleTo( Json::intValue ) );
+
+    JSON_CHECK( decode( "2147483647", decoded )  &&  decoded.isInt()  &&  decoded.isUInt() );
+    JSON_CHECK( decoded.isConvertibleTo( Json::intValue ) );
+    JSON_CHECK( decode( "2147483648", decoded )  &&  !decoded.isInt()  &&  decoded.isUInt() );
+    JSON_CHECK( !decoded.isConvertibleTo( Json::intValue )  &&  decoded.isConvertibleTo( Json::uintValue ) );
+    JSON_CHECK( decode( "-2147483648", decoded )  &&  decoded.isInt()  &&  !decoded.isUInt() );
+    JSON_CHECK( decode( "4294967296", decoded )  &&  !decoded.isUInt() );
+    JSON_CHECK( Json::Value( Json::Value::UInt( 5 ) ).isInt() );
+    JSON_CHECK( Json::Value( 5 ).isUInt() );
+#if defined(JSON_HAS_INT64)
+    JSON_CHECK( decode( "9223372036854775807", decoded )  &&  decoded.isInt64()  &&  decoded.isUInt64() );
+    JSON_CHECK( decode( "9223372036854775808", decoded )  &&  !decoded.isInt64()  &&  decoded.isUInt64() );
+    JSON_CHECK( decode( "-1", decoded )  &&  decoded.isInt64()  &&  !decoded.isUInt64() );
+#endif
+
+    // Every predicate that holds leaves its accessor free to return.
+    const char *texts[] = {
+        "0", "-1", "2147483647", "2147483648", "-2147483648", "-2147483649", "4294967295", "4294967296",
+        "1099511627776", "-1099511627776", "9223372036854775807", "18446744073709551615",
+    };
+    for ( const char *text : texts )
+    {
+        JSON_CHECK( decode( text, decoded ) );
+        bool intReturned = true;
+        bool uintReturned = true;
+        try
+        {
+            decoded.asInt();
+        }
+        catch ( const std::exception & )
+        {
+            intReturned = false;
+        }
+        try
+        {
+            decoded.asUInt();
+        }
+        catch ( const std::exception & )
+        {
+            uintReturned = false;
+        }
+        JSON_CHECK( decoded.isInt() == intReturned );
+        JSON_CHECK( decoded.isUInt() == uintReturned );
+        JSON_CHECK( decoded.isConvertibleTo( Json::intValue ) == intReturned );
+        JSON_CHECK( decoded.isConvertibleTo( Json::uintValue ) == uintReturned );
+    }
+}
+
+struct NullHandler : Json::ReaderHandler
+{
+};
+
+// A sign, a point or an exponent without digits is not a number, for the
+// tree and the handler parse alike.
+static void
+testMalformed()
+{
+    const char *documents[] = {
+        "[-]", "[1,-]", "{\"a\":-}", "-", "[-e5]", "[1e]", "[1e+]", "[-.e1]", "[.]",
+    };
+    for ( const char *document : documents )
+    {
+        Json::Reader reader;
+        Json::Value root;
+        JSON_CHECK( !reader.parse( document, root, false ) );
+        NullHandler handler;
+        JSON_CHECK( !reader.parse( document, document + strlen( document ), handler ) );
+    }
+}
+
+int
+main()
+{
+    testKnownDoubles();
+    testRandomDoubles();
+    testIntegers();
+    testIntegerRanges();
+    testMalformed();
+    return testResult();
+}
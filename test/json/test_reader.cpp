@@ -0,0 +1,351 @@
+// Reader, IncrementalReader and ReaderHandler: parsing and error reports.
+#include <json/json.h>
+#include "json_test.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Feeds document to an IncrementalReader in chunks of chunkSize bytes.
+static std::vector<Json::Value>
+readIncrementally( const char *document, size_t chunkSize )
+{
+    Json::IncrementalReader reader( true );
+    size_t length = strlen( document );
+    for ( size_t offset = 0; offset < length; offset += chunkSize )
+    {
+        JSON_CHECK( reader.feed( document + offset, std::min( chunkSize, length - offset ) ) );
+    }
+    JSON_CHECK( reader.finish() );
+    std::vector<Json::Value> values;
+    Json::Value value;
+    while ( reader.getNextValue( value ) )
+    {
+        values.push_back( value );
+    }
+    return values;
+}
+
+static bool
+sameComments( const Json::Value &a, const Json::Value &b )
+{
+    for ( int placement = 0; placement < Json::numberOfCommentPlacement; ++placement )
+    {
+        Json::CommentPlacement where = Json::CommentPlacement( placement );
+        if ( a.getComment( where ) != b.getComment( where ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A single value keeps the comments Reader::parse gives it, however the
+// document is split.
+static void
+testIncrementalComments()
+{
+    const char *documents[] = {
+        "{\"a\":1} // trailing\n",
+        "{\"a\":1} /* trailing */",
+        "// before\n[1, 2] /* after */\n",
+        "/* one */ // two\n\"text\" // three",
+        "{\"a\": 1 // member\n}\n",
+    };
+    for ( const char *document : documents )
+    {
+        Json::Reader reader;
+        Json::Value expected;
+        JSON_CHECK( reader.parse( document, expected ) );
+        for ( size_t chunkSize = 1; chunkSize <= strlen( document ); chunkSize *= 3 )
+        {
+            std::vector<Json::Value> values = readIncrementally( document, chunkSize );
+            JSON_CHECK( values.size() == 1 );
+            if ( values.size() == 1 )
+            {
+                JSON_CHECK( values[0] == expected );
+                JSON_CHECK( sameComments( values[0], expected ) );
+                JSON_CHECK( values[0].toStyledString() == expected.toStyledString() );
+            }
+        }
+    }
+
+    // In a stream, comments go with the value on their line, or with the
+    // next one if they are on lines of their own.
+    std::vector<Json::Value> values = readIncrementally( "1 // one\n// two\n2 3 /* three */\r\n4", 1 );
+    JSON_CHECK( values.size() == 4 );
+    if ( values.size() == 4 )
+    {
+        JSON_CHECK( values[0].getComment( Json::commentAfterOnSameLine ) == "// one\n" );
+        JSON_CHECK( values[1].getComment( Json::commentBefore ) == "// two\n" );
+        JSON_CHECK( !values[1].hasComment( Json::commentAfterOnSameLine ) );
+        JSON_CHECK( values[2].getComment( Json::commentAfterOnSameLine ) == "/* three */" );
+        JSON_CHECK( values[3].asInt() == 4  &&  !values[3].hasComment( Json::commentBefore ) );
+    }
+}
+
+static bool
+feed( Json::IncrementalReader &reader, const char *text )
+{
+    return reader.feed( text, strlen( text ) );
+}
+
+// Values are parsed, and errors reported, as soon as they close. Without
+// comments a value is handed out at once; with them, once its line is over.
+static void
+testIncrementalTiming()
+{
+    Json::IncrementalReader bad;
+    JSON_CHECK( !feed( bad, "[1 2]" ) );
+    JSON_CHECK( !bad.getFormatedErrorMessages().empty() );
+
+    Json::IncrementalReader reader( true );
+    Json::Value value;
+    JSON_CHECK( feed( reader, "{\"id\": 7} " ) );
+    JSON_CHECK( !reader.getNextValue( value ) );
+    JSON_CHECK( feed( reader, "/" ) );
+    JSON_CHECK( feed( reader, "/ seven\n" ) );
+    JSON_CHECK( reader.getNextValue( value ) );
+    JSON_CHECK( value["id"].asInt() == 7 );
+    JSON_CHECK( value.getComment( Json::commentAfterOnSameLine ) == "// seven\n" );
+
+    Json::IncrementalReader withoutComments;
+    JSON_CHECK( feed( withoutComments, "[8] // eight" ) );
+    JSON_CHECK( withoutComments.getNextValue( value ) );
+    JSON_CHECK( value[0u].asInt() == 8  &&  !value.hasComment( Json::commentAfterOnSameLine ) );
+}
+
+// \u0000 stays part of a string value whether the string lives on the
+// heap, in the parsed buffer or in an arena.
+static void
+testEmbeddedZero()
+{
+    const char document[] = "[\"a\\u0000b\", \"a string longer than inline \\u0000 storage\"]";
+    const std::string expected[] = {
+        std::string( "a\0b", 3 ), std::string( "a string longer than inline \0 storage", 37 ),
+    };
+    for ( int mode = 0; mode < 3; ++mode )
+    {
+        std::string buffer = document;
+        Json::ValueArena arena;
+        Json::Reader reader;
+        Json::Value root;
+        if ( mode == 2 )
+        {
+            reader.setAllocator( &arena );
+        }
+        JSON_CHECK( mode == 1 ? reader.parseInsitu( &buffer[0], &buffer[0] + buffer.size(), root, false )
+                              : reader.parse( buffer, root, false ) );
+        JSON_CHECK( root[0u].asString() == expected[0] );
+        JSON_CHECK( root[1u].asString() == expected[1] );
+    }
+}
+
+static std::string
+nested( int depth, const char *open, const char *inner, const char *close )
+{
+    std::string document;
+    for ( int level = 0; level < depth; ++level )
+    {
+        document += open;
+    }
+    document += inner;
+    for ( int level = 0; level < depth; ++level )
+    {
+        document += close;
+    }
+    return document;
+}
+
+struct NullHandler : Json::ReaderHandler
+{
+};
+
+// Nesting past the stack limit is an error, not a stack overflow, and a
+// raised limit lets the handler parse take any depth.
+static void
+testStackLimit()
+{
+    Json::Reader reader;
+    Json::Value root;
+    int limit = Json::Reader::defaultStackLimit;
+    JSON_CHECK( reader.parse( nested( limit, "[", "1", "]" ), root, false ) );
+    JSON_CHECK( !reader.parse( nested( limit + 1, "[", "1", "]" ), root, false ) );
+    JSON_CHECK( reader.getErrorCode() == Json::Reader::errorStackLimit );
+    JSON_CHECK( !reader.parse( nested( limit + 1, "{\"a\":", "1", "}" ), root, false ) );
+    JSON_CHECK( reader.getErrorCode() == Json::Reader::errorStackLimit );
+
+    reader.setStackLimit( 3 );
+    JSON_CHECK( reader.parse( "[{\"a\":[1]}]", root, false ) );
+    JSON_CHECK( !reader.parse( "[{\"a\":[[1]]}]", root, false ) );
+    JSON_CHECK( reader.getErrorCode() == Json::Reader::errorStackLimit );
+
+    std::string deep = nested( 200000, "[", "", "]" );
+    NullHandler handler;
+    Json::Reader handlerReader;
+    JSON_CHECK( !handlerReader.parse( deep.data(), deep.data() + deep.size(), handler ) );
+    JSON_CHECK( handlerReader.getErrorCode() == Json::Reader::errorStackLimit );
+    handlerReader.setStackLimit( 1000000 );
+    JSON_CHECK( handlerReader.parse( deep.data(), deep.data() + deep.size(), handler ) );
+    Json::Reader treeReader;
+    JSON_CHECK( !treeReader.parse( deep, root, false ) );
+    JSON_CHECK( treeReader.getErrorCode() == Json::Reader::errorStackLimit );
+}
+
+// Counts the events of a handler parse.
+struct CountingHandler : Json::ReaderHandler
+{
+    CountingHandler()
+        : events_( 0 )
+    {
+    }
+
+    virtual bool onInt( Json::Value::LargestInt )
+    {
+        ++events_;
+        return true;
+    }
+
+    virtual bool onUInt( Json::Value::LargestUInt )
+    {
+        ++events_;
+        return true;
+    }
+
+    virtual bool onStartArray()
+    {
+        ++events_;
+        return true;
+    }
+
+    virtual bool onEndArray()
+    {
+        ++events_;
+        return true;
+    }
+
+    int events_;
+};
+
+static size_t
+countErrors( const Json::Reader &reader )
+{
+    std::string messages = reader.getFormatedErrorMessages();
+    size_t count = 0;
+    for ( size_t position = messages.find( "* Line" ); position != std::string::npos;
+          position = messages.find( "* Line", position + 1 ) )
+    {
+        ++count;
+    }
+    return count;
+}
+
+// Strict mode stops at the first error, where getErrorCode() and
+// getErrorOffset() report it, and rejects comments and anything after
+// the root value, for the tree and the handler parse alike.
+static void
+testStrictMode()
+{
+    Json::Reader reader;
+    reader.setStrictMode( true );
+    Json::Value root;
+    std::string document = "[[1 2], [3 4]]";
+    JSON_CHECK( !reader.parse( document, root ) );
+    JSON_CHECK( reader.getErrorCode() == Json::Reader::errorMissingArrayEnd );
+    JSON_CHECK( reader.getErrorOffset() == document.find( '2' ) );
+    JSON_CHECK( countErrors( reader ) == 1 );
+    JSON_CHECK( root.size() == 1u  &&  root[0u].size() == 1u  &&  root[0u][0u].asInt() == 1 );
+
+    const char *commented[] = { "[1, /* c */ 2]", "// c\n[1]", "{\"a\": // c\n1}" };
+    for ( const char *text : commented )
+    {
+        Json::Reader lenient;
+        JSON_CHECK( lenient.parse( text, root ) );
+        JSON_CHECK( !reader.parse( text, root ) );
+        JSON_CHECK( reader.getErrorCode() == Json::Reader::errorValueExpected );
+        JSON_CHECK( reader.getErrorOffset() == std::string( text ).find( '/' ) );
+    }
+
+    const char *extra[] = { "[1] 2", "[1] // c\n", "[1]  ]" };
+    for ( const char *text : extra )
+    {
+        Json::Reader lenient;
+        JSON_CHECK( lenient.parse( text, root ) );
+        JSON_CHECK( !reader.parse( text, root ) );
+        JSON_CHECK( reader.getErrorCode() == Json::Reader::errorExtraData );
+        JSON_CHECK( reader.getErrorOffset() == std::string( text ).find_first_not_of( " ", 3 ) );
+        JSON_CHECK( reader.getFormatedErrorMessages().find( "Extra data after the root value.\n" )
+                    != std::string::npos );
+    }
+    JSON_CHECK( reader.parse( " [1]\r\n\t", root ) );
+    JSON_CHECK( reader.getErrorCode() == Json::Reader::errorNone );
+
+    const char *handled[] = { "[1, 2 3, 4]", "[1, /* c */ 2]", "[1, 2] 3" };
+    const Json::Reader::ErrorCode codes[] = {
+        Json::Reader::errorMissingArrayEnd, Json::Reader::errorValueExpected, Json::Reader::errorExtraData,
+    };
+    const int events[] = { 3, 2, 4 };
+    for ( int index = 0; index < 3; ++index )
+    {
+        std::string text = handled[index];
+        CountingHandler handler;
+        JSON_CHECK( !reader.parse( text.data(), text.data() + text.size(), handler ) );
+        JSON_CHECK( reader.getErrorCode() == codes[index] );
+        JSON_CHECK( reader.getErrorOffset() == text.find_first_of( "3/", 2 ) );
+        JSON_CHECK( countErrors( reader ) == 1 );
+        JSON_CHECK( handler.events_ == events[index] );
+    }
+}
+
+// Objects are read in any member order and sorted once complete: the
+// last of duplicate names wins, and comments stay with their members
+// and elements however the storage moves while it grows.
+static void
+testMemberOrder()
+{
+    std::string document = "{";
+    std::string array = "[";
+    for ( int index = 40; index > 0; --index )
+    {
+        std::string number = std::to_string( index );
+        document += "\"m" + std::string( index < 10 ? "0" : "" ) + number + "\": " + number + ", // c" + number + "\n";
+        array += number + ", // e" + number + "\n";
+    }
+    document += "\"m05\": \"last\", \"items\": " + array + "0]}";
+
+    Json::Reader reader;
+    Json::Value root;
+    JSON_CHECK( reader.parse( document, root ) );
+    JSON_CHECK( root.size() == 41u );
+    JSON_CHECK( root["m05"].asString() == "last" );
+    std::string previous;
+    for ( Json::Value::iterator it = root.begin(); it != root.end(); ++it )
+    {
+        JSON_CHECK( previous < it.memberName() );
+        previous = it.memberName();
+    }
+    for ( int index = 1; index <= 40; ++index )
+    {
+        std::string number = std::to_string( index );
+        const Json::Value &items = root["items"];
+        JSON_CHECK( items[40 - index].getComment( Json::commentAfterOnSameLine ) == "// e" + number + "\n" );
+        if ( index != 5 )
+        {
+            const Json::Value &member = root["m" + std::string( index < 10 ? "0" : "" ) + number];
+            JSON_CHECK( member.asInt() == index );
+            JSON_CHECK( member.getComment( Json::commentAfterOnSameLine ) == "// c" + number + "\n" );
+        }
+    }
+}
+
+int
+main()
+{
+    testIncrementalComments();
+    testIncrementalTiming();
+    testEmbeddedZero();
+    testStackLimit();
+    testMemberOrder();
+    testStrictMode();
+    return testResult();
+}
@@ -0,0 +1,174 @@
+// Tape: indexing documents and reading values through TapeView.
+#include <json/json.h>
+#include "json_test.h"
+#include <cstring>
+#include <random>
+#include <string>
+
+static bool
+index( const std::string &document, Json::Tape &tape, Json::Reader &reader )
+{
+    return reader.parse( document.data(), document.data() + document.size(), tape );
+}
+
+static bool
+index( const std::string &document, Json::Tape &tape )
+{
+    Json::Reader reader;
+    return index( document, tape, reader );
+}
+
+// Integers read through a view as they do through the decoded Value,
+// including the ones only the 64-bit accessors hold.
+static void
+testIntegerAccessors()
+{
+    std::string document = "{\"small\": -7, \"big\": -9223372036854775808, "
+                           "\"huge\": 18446744073709551615, \"real\": 2.5}";
+    Json::Tape tape;
+    JSON_CHECK( index( document, tape ) );
+    Json::TapeView root = tape.root();
+    JSON_CHECK( root["small"].asInt() == -7 );
+    JSON_CHECK( root["small"].asLargestInt() == -7 );
+    JSON_CHECK( root["big"].asLargestInt() == Json::Value::minLargestInt );
+    JSON_CHECK( root["huge"].asLargestUInt() == Json::Value::maxLargestUInt );
+    JSON_CHECK( root["real"].asLargestInt() == 2 );
+    JSON_CHECK( root["missing"].asLargestUInt() == 0 );
+#if defined(JSON_HAS_INT64)
+    JSON_CHECK( root["big"].asInt64() == Json::Value::minInt64 );
+    JSON_CHECK( root["huge"].asUInt64() == Json::Value::maxUInt64 );
+    JSON_CHECK( root["small"].asInt64() == -7 );
+#endif
+}
+
+// Checks that view reads as value does, member by member.
+static bool
+sameContent( const Json::TapeView &view, const Json::Value &value )
+{
+    if ( !view.isValid()  ||  view.type() != value.type() )
+    {
+        return false;
+    }
+    if ( value.isArray() )
+    {
+        if ( view.size() != value.size() )
+        {
+            return false;
+        }
+        for ( Json::Value::ArrayIndex index = 0; index < value.size(); ++index )
+        {
+            if ( !sameContent( view[index], value[index] ) )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    if ( value.isObject() )
+    {
+        if ( view.size() != value.size() )
+        {
+            return false;
+        }
+        Json::Value::Members names = value.getMemberNames();
+        for ( const std::string &name : names )
+        {
+            if ( !sameContent( view[name], value[name] ) )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    return view.asValue() == value;
+}
+
+// Records with escaped quotes and backslash runs in their strings, so
+// that escapes straddle the 64-byte blocks of the structural index.
+static std::string
+makeDocument( size_t size, bool pretty )
+{
+    std::mt19937 random( 25 );
+    std::string document = "[";
+    for ( int record = 0; document.size() < size; ++record )
+    {
+        document += record ? "," : "";
+        document += pretty ? "\n  {\n    \"id\" : " : "{\"id\":";
+        document += std::to_string( record );
+        document += pretty ? ",\n    \"text\" : \"" : ",\"text\":\"";
+        document += std::string( random() % 70, 'x' ) + ( record % 3 ? "\\\"" : "\\\\" );
+        document += std::string( random() % 70, 'y' ) + ( record % 4 ? "\\u00e9" : "\\\\\\\"" ) + "\"";
+        document += pretty ? ",\n    \"values\" : [ 1.5, -2e3, true, false, null, {} ]\n  }"
+                           : ",\"values\":[1.5,-2e3,true,false,null,{}]}";
+    }
+    return document + "]";
+}
+
+// Documents of 16 KB or more are indexed; small ones and ones with
+// comments go through the tokenizer. Both must give the same tape.
+static void
+testIndexedMatchesTokenizer()
+{
+    for ( int pretty = 0; pretty < 2; ++pretty )
+    {
+        std::string large = makeDocument( 40000, pretty != 0 );
+        std::string small = makeDocument( 4000, pretty != 0 );
+        std::string commented = "/* tokenizer */ " + large;
+        Json::Value expectedLarge, expectedSmall;
+        JSON_CHECK( Json::Reader().parse( large, expectedLarge, false ) );
+        JSON_CHECK( Json::Reader().parse( small, expectedSmall, false ) );
+
+        Json::Tape indexed, tokenized, smallTape;
+        JSON_CHECK( index( large, indexed ) );
+        JSON_CHECK( index( commented, tokenized ) );
+        JSON_CHECK( index( small, smallTape ) );
+        JSON_CHECK( indexed.size() == tokenized.size() );
+        JSON_CHECK( sameContent( indexed.root(), expectedLarge ) );
+        JSON_CHECK( sameContent( tokenized.root(), expectedLarge ) );
+        JSON_CHECK( sameContent( smallTape.root(), expectedSmall ) );
+    }
+}
+
+// Mutated large documents fail or succeed alike on both paths, with the
+// same error at the same place.
+static void
+testMutatedDocuments()
+{
+    const std::string document = makeDocument( 20000, false );
+    const char replacements[] = "{}[],:\"\\ x1-.e";
+    const std::string prefix = "/**/";
+    std::mt19937 random( 2525 );
+    for ( int mutation = 0; mutation < 400; ++mutation )
+    {
+        std::string mutated = document;
+        size_t position = random() % mutated.size();
+        if ( mutation % 10 == 0 )
+        {
+            mutated.resize( position );
+        }
+        else
+        {
+            mutated[position] = replacements[random() % ( sizeof(replacements) - 1 )];
+        }
+        Json::Reader indexedReader, tokenizerReader;
+        Json::Tape indexed, tokenized;
+        bool indexedOk = index( mutated, indexed, indexedReader );
+        bool tokenizedOk = index( prefix + mutated, tokenized, tokenizerReader );
+        JSON_CHECK( indexedOk == tokenizedOk );
+        JSON_CHECK( indexedReader.getErrorCode() == tokenizerReader.getErrorCode() );
+        if ( !indexedOk )
+        {
+            JSON_CHECK( indexedReader.getErrorOffset() + prefix.size() == tokenizerReader.getErrorOffset() );
+        }
+        JSON_CHECK( indexed.size() == tokenized.size() );
+    }
+}
+
+int
+main()
+{
+    testIntegerAccessors();
+    testIndexedMatchesTokenizer();
+    testMutatedDocuments();
+    return testResult();
+}
@@ -0,0 +1,393 @@
+// Value containers: member storage, lookup and ordering.
+#include <json/json.h>
+#include "json_test.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Counts heap allocations, operator new's included, by interposing the C
+// allocator as json_bench does. Only glibc builds can count.
+static size_t allocations = 0;
+
+#if defined(__GLIBC__)
+# define JSON_TEST_COUNTS_ALLOCATIONS
+extern "C" void *__libc_malloc( size_t size );
+extern "C" void *__libc_calloc( size_t count, size_t size );
+extern "C" void *__libc_realloc( void *block, size_t size );
+
+extern "C" void *
+malloc( size_t size ) throw()
+{
+    ++allocations;
+    return __libc_malloc( size );
+}
+
+extern "C" void *
+calloc( size_t count, size_t size ) throw()
+{
+    ++allocations;
+    return __libc_calloc( count, size );
+}
+
+extern "C" void *
+realloc( void *block, size_t size ) throw()
+{
+    ++allocations;
+    return __libc_realloc( block, size );
+}
+#endif
+
+// Members are inserted in scrambled order, some of them with comments,
+// which keep their members from being moved bytewise.
+static void
+testObjectMembers()
+{
+    Json::Value object( Json::objectValue );
+    const int size = 1000;
+    for ( int index = 0; index < size; ++index )
+    {
+        int key = index * 7919 % size;
+        object["m" + std::to_string( key )] = key;
+        if ( key % 97 == 0 )
+        {
+            object["m" + std::to_string( key )].setComment( "// c" + std::to_string( key ), Json::commentBefore );
+        }
+    }
+    JSON_CHECK( object.size() == Json::Value::UInt( size ) );
+
+    const Json::Value &constObject = object;
+    std::string previous;
+    int count = 0;
+    for ( Json::Value::const_iterator it = constObject.begin(); it != constObject.end(); ++it, ++count )
+    {
+        std::string name = it.key().asString();
+        JSON_CHECK( previous < name );
+        JSON_CHECK( "m" + std::to_string( (*it).asInt() ) == name );
+        previous = name;
+    }
+    JSON_CHECK( count == size );
+    for ( int key = 0; key < size; ++key )
+    {
+        const Json::Value &member = object["m" + std::to_string( key )];
+        JSON_CHECK( member.asInt() == key );
+        JSON_CHECK( member.hasComment( Json::commentBefore ) == (key % 97 == 0) );
+        if ( key % 97 == 0 )
+        {
+            JSON_CHECK( member.getComment( Json::commentBefore ) == "// c" + std::to_string( key ) );
+        }
+    }
+
+    for ( int key = 0; key < size; key += 3 )
+    {
+        Json::Value removed = object.removeMember( "m" + std::to_string( key ) );
+        JSON_CHECK( removed.asInt() == key );
+        JSON_CHECK( removed.hasComment( Json::commentBefore ) == (key % 97 == 0) );
+    }
+    for ( int key = 0; key < size; ++key )
+    {
+        std::string name = "m" + std::to_string( key );
+        JSON_CHECK( object.isMember( name ) == (key % 3 != 0) );
+        if ( key % 3 != 0 )
+        {
+            JSON_CHECK( object[name].asInt() == key );
+            JSON_CHECK( object[name].hasComment( Json::commentBefore ) == (key % 97 == 0) );
+        }
+    }
+}
+
+// Small objects keep up to four members inline, then move them out.
+static void
+testSmallObjects()
+{
+    Json::Value object( Json::objectValue );
+    const char *names[] = { "delta", "alpha", "echo", "charlie", "bravo", "a-much-longer-member-name" };
+    for ( int index = 0; index < 6; ++index )
+    {
+        object[names[index]] = names[index];
+        for ( int check = 0; check <= index; ++check )
+        {
+            JSON_CHECK( object[names[check]].asString() == names[check] );
+        }
+    }
+    Json::Value::Members members = object.getMemberNames();
+    JSON_CHECK( members.size() == 6  &&  members[0] == "a-much-longer-member-name"  &&  members[5] == "echo" );
+    Json::Value copy = object;
+    JSON_CHECK( copy == object );
+    const Json::Value &constObject = object;
+    JSON_CHECK( constObject["missing"].isNull()  &&  !object.isMember( "missing" ) );
+}
+
+// Appending an element of the array itself, as the array grows past
+// every capacity, copies the element before the storage moves.
+static void
+testAppendAliasing()
+{
+    Json::Value array( Json::arrayValue );
+    array.append( "a string too long to be stored inline" );
+    for ( int count = 1; count < 100; ++count )
+    {
+        array.append( array[0u] );
+        JSON_CHECK( array.size() == Json::Value::UInt( count + 1 ) );
+        JSON_CHECK( array[count].asString() == "a string too long to be stored inline" );
+    }
+    JSON_CHECK( array[0u].asString() == "a string too long to be stored inline" );
+
+    Json::Value numbers( Json::arrayValue );
+    numbers.append( 1 );
+    for ( int count = 1; count < 40; ++count )
+    {
+        numbers.append( numbers[count - 1] );
+        numbers[count] = numbers[count].asInt() + 1;
+    }
+    JSON_CHECK( numbers[39].asInt() == 40 );
+
+    Json::Value moved( Json::arrayValue );
+    moved.append( "another string too long to be inline" );
+    for ( int count = 1; count < 40; ++count )
+    {
+        moved.append( std::move( moved[count - 1] ) );
+        JSON_CHECK( moved[count - 1].isNull() );
+    }
+    JSON_CHECK( moved[39].asString() == "another string too long to be inline" );
+}
+
+// Builds a tree and records the allocation count once it is complete.
+static Json::Value
+makeTree( size_t &allocationsBuilt )
+{
+    Json::Value tree( Json::objectValue );
+    tree["name"] = "a string too long to be stored inline";
+    tree["items"].append( "another string too long to be inline" );
+    tree["items"].append( Json::Value( Json::objectValue ) );
+    allocationsBuilt = allocations;
+    return tree;
+}
+
+// Moves hand the payload over: moving a value, appending or assigning
+// one by move, removing a member and returning a tree allocate nothing.
+static void
+testMovesDoNotAllocate()
+{
+#if defined(JSON_TEST_COUNTS_ALLOCATIONS)
+    size_t built = 0;
+    Json::Value tree = makeTree( built );
+    JSON_CHECK( allocations == built );
+
+    size_t before = allocations;
+    Json::Value moved( std::move( tree ) );
+    JSON_CHECK( allocations == before );
+    JSON_CHECK( tree.isNull()  &&  moved["items"].size() == 2u );
+
+    Json::Value array( Json::arrayValue );
+    array.resize( 4 );
+    array.resize( 0 );
+    before = allocations;
+    array.append( std::move( moved ) );
+    JSON_CHECK( allocations == before );
+    JSON_CHECK( moved.isNull()  &&  array[0u]["items"].size() == 2u );
+
+    Json::Value text( "a third string too long to be inline" );
+    before = allocations;
+    array[0u]["name"] = std::move( text );
+    JSON_CHECK( allocations == before );
+    JSON_CHECK( text.isNull()  &&  array[0u]["name"].asString() == "a third string too long to be inline" );
+
+    before = allocations;
+    Json::Value removed = array[0u].removeMember( "items" );
+    JSON_CHECK( allocations == before );
+    JSON_CHECK( removed.size() == 2u  &&  !array[0u].isMember( "items" ) );
+#endif
+}
+
+static const char sharedDocument[] =
+    "{\"name\": \"a string too long to be stored inline\", "
+    "\"items\": [1, {\"tags\": [\"x\", \"y\"], \"deep\": {\"level\": 3}}, [4, 5]]}";
+
+static Json::Value
+parseShared()
+{
+    Json::Reader reader;
+    Json::Value root;
+    JSON_CHECK( reader.parse( sharedDocument, root, false ) );
+    return root;
+}
+
+// Copies of a shared tree read the same storage, and mutating any of
+// them, however deep, changes that one alone.
+static void
+testSharedCopiesAreIsolated()
+{
+    Json::Value original = parseShared();
+    Json::Value expected = original;
+    original.share();
+    Json::Value first = original;
+    Json::Value second = original;
+    const Json::Value &reader = second;
+    const Json::Value &originalReader = original;
+    JSON_CHECK( &reader["items"][1u]["deep"] == &originalReader["items"][1u]["deep"] );
+
+    first["items"][1u]["deep"]["level"] = 4;
+    first["items"][1u]["tags"].append( "z" );
+    original["items"][2u][0u] = "changed";
+    original["name"] = 0;
+
+    JSON_CHECK( first["items"][1u]["deep"]["level"].asInt() == 4 );
+    JSON_CHECK( first["items"][1u]["tags"].size() == 3u );
+    JSON_CHECK( first["items"][2u][0u].asInt() == 4 );
+    JSON_CHECK( first["name"] == expected["name"] );
+    JSON_CHECK( original["items"][1u] == expected["items"][1u] );
+    JSON_CHECK( original["items"][2u][0u].asString() == "changed" );
+    JSON_CHECK( second == expected );
+}
+
+// Containers built in an allocator are copied, never shared, so copies
+// do not depend on the tree they came from.
+static void
+testShareInAllocator()
+{
+    Json::ValueArena arena;
+    Json::Reader reader;
+    reader.setAllocator( &arena );
+    Json::Value original;
+    JSON_CHECK( reader.parse( sharedDocument, original, false ) );
+    original.share();
+    Json::Value copy = original;
+    const Json::Value &copyReader = copy;
+    const Json::Value &originalReader = original;
+    JSON_CHECK( &copyReader["items"] != &originalReader["items"] );
+    JSON_CHECK( &copyReader["items"][1u]["deep"] != &originalReader["items"][1u]["deep"] );
+
+    copy["items"][1u]["deep"]["level"] = 4;
+    JSON_CHECK( original["items"][1u]["deep"]["level"].asInt() == 3 );
+    original = Json::Value();
+    JSON_CHECK( copy["items"][1u]["tags"][1u].asString() == "y" );
+}
+
+// The last owner of shared storage releases it, whichever it is.
+static void
+testSharedCopiesOutliveOriginal()
+{
+    Json::Value *original = new Json::Value( parseShared() );
+    original->share();
+    Json::Value first = *original;
+    Json::Value second = first;
+    delete original;
+    JSON_CHECK( first == parseShared() );
+    second["items"][1u]["tags"][0u] = "w";
+    first = Json::Value();
+    JSON_CHECK( second["items"][1u]["tags"][0u].asString() == "w" );
+    JSON_CHECK( second["items"][1u]["deep"]["level"].asInt() == 3 );
+}
+
+// Threads copy one shared tree and mutate their copies concurrently;
+// each sees its own changes only, and the tree is left as it was.
+static void
+testSharedAcrossThreads()
+{
+    const Json::Value expected = parseShared();
+    Json::Value original = expected;
+    original.share();
+    std::vector<int> failures( 4, 0 );
+    std::vector<std::thread> threads;
+    for ( int thread = 0; thread < 4; ++thread )
+    {
+        threads.push_back( std::thread( [&original, &expected, &failures, thread]()
+        {
+            const Json::Value &tree = original;
+            for ( int round = 0; round < 2000; ++round )
+            {
+                Json::Value copy = tree;
+                copy["items"][1u]["deep"]["level"] = thread;
+                copy["items"][1u]["tags"].append( round );
+                Json::Value nested = copy["items"];
+                nested[2u][1u] = round;
+                if ( copy["items"][1u]["deep"]["level"].asInt() != thread
+                     ||  copy["items"][1u]["tags"].size() != 3u
+                     ||  copy["items"][2u][1u].asInt() != 5
+                     ||  nested[2u][1u].asInt() != round
+                     ||  tree["items"][1u]["deep"]["level"].asInt() != 3 )
+                {
+                    ++failures[thread];
+                }
+            }
+            Json::Value::releaseThreadCache();
+        } ) );
+    }
+    for ( std::thread &thread : threads )
+    {
+        thread.join();
+    }
+    for ( int count : failures )
+    {
+        JSON_CHECK( count == 0 );
+    }
+    JSON_CHECK( original == expected );
+}
+
+// Two threads parsing the same names into one table, in opposite orders,
+// end up with the same single copy of each name.
+static void
+testMemberNamesAcrossThreads()
+{
+    std::string documents[2] = { "{", "{" };
+    for ( int index = 0; index < 500; ++index )
+    {
+        std::string member = "\"sharedMemberName" + std::to_string( index ) + "\": 0";
+        std::string reversed = "\"sharedMemberName" + std::to_string( 499 - index ) + "\": 0";
+        documents[0] += ( index ? ", " : "" ) + member;
+        documents[1] += ( index ? ", " : "" ) + reversed;
+    }
+    documents[0] += "}";
+    documents[1] += "}";
+
+    Json::MemberNameTable table;
+    Json::Value roots[2];
+    std::atomic<int> ready( 0 );
+    std::vector<std::thread> threads;
+    for ( int thread = 0; thread < 2; ++thread )
+    {
+        threads.push_back( std::thread( [&documents, &table, &roots, &ready, thread]()
+        {
+            Json::Reader reader;
+            reader.setMemberNameTable( &table );
+            ++ready;
+            while ( ready.load() < 2 )
+            {
+                std::this_thread::yield();
+            }
+            reader.parse( documents[thread], roots[thread], false );
+            Json::Value::releaseThreadCache();
+        } ) );
+    }
+    for ( std::thread &thread : threads )
+    {
+        thread.join();
+    }
+
+    JSON_CHECK( table.size() == 500u );
+    JSON_CHECK( roots[0].size() == 500u  &&  roots[1].size() == 500u );
+    Json::Value::iterator first = roots[0].begin();
+    Json::Value::iterator second = roots[1].begin();
+    for ( ; first != roots[0].end()  &&  second != roots[1].end(); ++first, ++second )
+    {
+        JSON_CHECK( first.memberName() == second.memberName() );
+        JSON_CHECK( first.memberName() == table.intern( first.memberName() ) );
+    }
+}
+
+int
+main()
+{
+    testObjectMembers();
+    testSmallObjects();
+    testAppendAliasing();
+    testMovesDoNotAllocate();
+    testSharedCopiesAreIsolated();
+    testShareInAllocator();
+    testSharedCopiesOutliveOriginal();
+    testSharedAcrossThreads();
+    testMemberNamesAcrossThreads();
+    return testResult();
+}
@@ -0,0 +1,92 @@
+// Writers: double formatting and what the writers produce.
+#include <json/json.h>
+#include "json_test.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+static bool
+sameBits( double a, double b )
+{
+    return memcmp( &a, &b, sizeof(double) ) == 0;
+}
+
+// Written text must read back to the same double through strtod and
+// through the Reader.
+static void
+checkRoundTrip( double value )
+{
+    std::string text = Json::valueToString( value );
+    Json::Reader reader;
+    Json::Value root;
+    bool parsed = reader.parse( "[" + text + "]", root, false );
+    if ( !parsed  ||  !root[0u].isDouble()  ||  !sameBits( root[0u].asDouble(), value )
+         ||  !sameBits( strtod( text.c_str(), 0 ), value ) )
+    {
+        printf( "%.17g written as %s\n", value, text.c_str() );
+        ++testFailures;
+    }
+}
+
+static void
+testDoubleFormat()
+{
+    JSON_CHECK( Json::valueToString( 0.1 ) == "0.1" );
+    JSON_CHECK( Json::valueToString( 3.25 ) == "3.25" );
+    JSON_CHECK( Json::valueToString( 1.0 ) == "1.0" );
+    JSON_CHECK( Json::valueToString( 0.0 ) == "0.0" );
+    JSON_CHECK( Json::valueToString( -0.0 ) == "-0.0" );
+    JSON_CHECK( Json::valueToString( 1e16 ) == "10000000000000000.0" );
+    JSON_CHECK( Json::valueToString( 1e17 ) == "1e+17" );
+    JSON_CHECK( Json::valueToString( 0.00001 ) == "0.00001" );
+    JSON_CHECK( Json::valueToString( 0.000001 ) == "1e-6" );
+    JSON_CHECK( Json::valueToString( -1.5e300 ) == "-1.5e+300" );
+    JSON_CHECK( Json::valueToString( 5e-324 ) == "5e-324" );
+    JSON_CHECK( Json::valueToString( 1.7976931348623157e308 ) == "1.7976931348623157e+308" );
+}
+
+static void
+testDoubleRoundTrip()
+{
+    const double known[] = {
+        0.1, 0.2, 0.3, 1e23, 5e-324, 2.2250738585072014e-308, 2.2250738585072009e-308,
+        1.7976931348623157e308, 9007199254740993.0, 123456.789, 1e-5, 1e17, -0.0,
+    };
+    for ( double value : known )
+    {
+        checkRoundTrip( value );
+    }
+
+    // Random bit patterns cover every exponent; short decimals are the
+    // values documents usually hold.
+    std::mt19937_64 random( 8 );
+    for ( int count = 0; count < 500000; ++count )
+    {
+        unsigned long long bits = random();
+        double value;
+        memcpy( &value, &bits, sizeof(double) );
+        if ( value == value  &&  value - value == 0 )
+        {
+            checkRoundTrip( value );
+        }
+    }
+    for ( int count = 0; count < 200000; ++count )
+    {
+        checkRoundTrip( double( random() % 1000000 ) / 1000 );
+    }
+    for ( int exponent = -1074; exponent <= 1023; ++exponent )
+    {
+        checkRoundTrip( ldexp( 1.0, exponent ) );
+        checkRoundTrip( nextafter( ldexp( 1.0, exponent ), 0.0 ) );
+    }
+}
+
+int
+main()
+{
+    testDoubleFormat();
+    testDoubleRoundTrip();
+    return testResult();
+}